@@ -0,0 +1,120 @@
+/**
+ * @file config.h
+ * @brief Runtime parameters kept in two dedicated flash sectors.
+ *
+ * The tunable timing parameters live in one RAM struct, `config`. It is
+ * loaded once at boot from the newest valid record of the config sectors
+ * (CONFIG region of the linker scripts, flash sectors 6 and 7), or set to
+ * the compile-time defaults below when there is none. Hot paths read a
+ * field of `config` directly, which is a plain load.
+ *
+ * Each sector is an append-only log of fixed-size, CRC-checked records,
+ * and the two take turns:
+ * 	- A save programs one new record after the last one of the live
+ * 	  sector, so a sector is erased only once every CONFIG_SLOTS saves.
+ * 	  Each save wears one record of flash instead of the whole sector.
+ * 	- When the live sector is full the record goes to slot 0 of the other,
+ * 	  erased one, which becomes live. Only then is the full sector erased,
+ * 	  so flash holds a valid record whenever a reset hits.
+ * 	- Slots fill in order, so boot finds the last programmed slot of each
+ * 	  sector by binary search (log2(CONFIG_SLOTS) reads) and then checks
+ * 	  CRCs backwards until one is valid; the higher sequence wins. A record
+ * 	  torn by a reset fails its CRC and the previous one is used.
+ * 	- Writes happen in the main loop (config_poll()), never in the caller
+ * 	  of config_save(). The F446 has a single flash bank: programming a
+ * 	  record stalls instruction fetches for a few word writes, a sector
+ * 	  erase stalls them - interrupts included - for 1-2 s. An erase is
+ * 	  therefore started only while the controller rests (controller_idle()),
+ * 	  with the lights holding and no interval running; detections during
+ * 	  the stall are latched and served after it.
+*/
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "policy.h"
+#include "estimator.h"
+#include "controller.h"
+
+/** @brief Config sectors - must match the CONFIG region of the linker scripts */
+#define CONFIG_SECTOR			6U			// First sector, CONFIG_SECTORS in a row
+#define CONFIG_SECTORS			2U
+#define CONFIG_SECTOR_SIZE		(128U * 1024U)
+
+/** @brief Record layout version, part of the record magic - bump when CONFIG_PARAMS changes */
+#define CONFIG_VERSION			1U
+#define CONFIG_MAGIC			(0x43464700U | CONFIG_VERSION)		// "CFG" + version
+
+#define CONFIG_ERASE_POLL_MS	50			// BSY check interval while the sector is erased
+
+/**
+ * @brief Parameters: X(ID, field, default, min, max), all uint32_t milliseconds.
+ *
+ * The ranges keep the fixed-point products of the estimator within 32 bits.
+*/
+#define CONFIG_PARAMS(X)															\
+	X(PASSAGE,			passageTime,		PASSAGE_TIME,			500,	10000)		\
+	X(MAX_GREEN,		maxGreen,			MAX_GREEN_TIME,			5000,	120000)		\
+	X(MAX_WAIT,			maxPhaseWait,		MAX_PHASE_WAIT_MS,		10000,	600000)		\
+	X(BATCH_WINDOW,		batchWindowMax,		BATCH_WINDOW_MAX_MS,	0,		10000)		\
+	X(BATCH_GAP,		batchIdleGap,		BATCH_IDLE_GAP_MS,		1000,	60000)		\
+	X(GREEN_MIN,		greenMin,			GREEN_MIN_MS,			1000,	20000)		\
+	X(GREEN_MAX,		greenMax,			GREEN_MAX_MS,			5000,	60000)		\
+	X(GREEN_STARTUP,	greenStartup,		GREEN_STARTUP_MS,		0,		5000)		\
+	X(GREEN_EXTENSION,	greenExtension,		GREEN_EXTENSION_MS,		500,	5000)
+
+#define CONFIG_FIELD(id, field, def, min, max)		uint32_t field;
+#define CONFIG_ID(id, field, def, min, max)			PARAM_##id,
+
+/** @brief Parameter values */
+typedef struct {
+	CONFIG_PARAMS(CONFIG_FIELD)
+} Config;
+
+/** @brief Parameter index, in CONFIG_PARAMS order */
+typedef enum {
+	CONFIG_PARAMS(CONFIG_ID)
+	NUM_PARAMS
+} ConfigParam;
+
+/** @brief One record of the config sector */
+typedef struct {
+	uint32_t magic;			/**< CONFIG_MAGIC - programmed first, marks the slot used */
+	uint32_t sequence;		/**< Save counter */
+	Config params;
+	uint32_t crc;			/**< CRC-32 of the words before it - programmed last */
+} ConfigRecord;
+
+#define CONFIG_SLOTS			(CONFIG_SECTOR_SIZE / sizeof(ConfigRecord))		// Records per sector
+
+/** @brief Outcome of the boot load and of the saves since */
+typedef struct {
+	bool loaded;			/**< Values came from flash, not the defaults */
+	uint32_t sequence;		/**< Sequence of the loaded or last saved record */
+	uint32_t sector;		/**< Flash sector of that record */
+	uint32_t slot;			/**< Slot of that record in its sector */
+	uint32_t probes;		/**< Slots read by the boot load (binary search + CRC checks) */
+	uint32_t loadUs;		/**< Time of the boot load (µs) */
+	uint32_t saves;			/**< Records programmed since boot */
+	uint32_t erases;		/**< Sector erases since boot */
+	uint32_t errors;		/**< Programming or verify failures */
+} ConfigStatus;
+
+/** @brief Current parameters - read directly on hot paths */
+extern Config config;
+
+// Function Prototypes
+void config_init(void);
+bool config_set(ConfigParam param, uint32_t value);
+uint32_t config_get(ConfigParam param);
+int32_t config_find(const char *name);
+const char *config_name(ConfigParam param);
+void config_defaults(void);
+void config_save(void);
+bool config_busy(void);
+void config_poll(void);
+const ConfigStatus *config_status(void);
+
+#endif /* CONFIG_H_ */
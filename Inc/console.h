@@ -0,0 +1,36 @@
+/**
+ * @file console.h
+ * @brief Line-oriented command console on USART2.
+ *
+ * USART2_IRQHandler() only moves received bytes into the receive ring
+ * (uart.c). console_poll() runs from the main loop, assembles a line and
+ * executes it, so commands never run in interrupt context. A line is
+ * tokenized in place in a static buffer - nothing is allocated.
+ *
+ * Commands (one per line, CR or LF terminated, no echo):
+ * 	- `help`                   list the commands
+ * 	- `stats`                  controller, lane, queue and monitor counters
+ * 	- `get [param]`            one or every runtime parameter (config.h)
+ * 	- `set <param> <value>`    change a parameter in RAM
+ * 	- `save`                   write the parameters to the flash store
+ * 	- `force phase <n|name>`   serve a phase next (numbered from 1)
+ * 	- `trace on|off`           log every controller state transition
+ * 	- `export`                 stream the statistics bins (stats.h)
+*/
+
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @brief Longest command line in bytes, terminator excluded */
+#define CONSOLE_LINE_MAX		64
+
+/** @brief Most words per command line */
+#define CONSOLE_MAX_ARGS		4
+
+// Function Prototypes
+void console_poll(void);
+
+#endif /* CONSOLE_H_ */
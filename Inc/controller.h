@@ -5,21 +5,36 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "stm32f446xx.h"
+#include "pinmap.h"
+#include "intersection.h"
 
-#define BUTTON1				(1U<<10)
-#define BUTTON2				(1U<<11)
-#define BUTTON3				(1U<<12)
-#define BUTTON4				(1U<<13)
-
-#define BUTTONS			       4
+#define BUTTONS				PINMAP_NUM_DETECTORS		// Detectors of the pin map
+#define BUTTON_PINS			PINMAP_DETECTOR_PINS
+#define BUTTON_SHIFT		__builtin_ctz(BUTTON_PINS)	// Pin of the first detector - detector n is pin BUTTON_SHIFT + n
 
 #define THRESHOLD			   3
-#define DEBOUNCE_TIME  		  100
 
-#define MAX_WAITING_PAIR	   2
+#define PASSAGE_TIME		 2000		// Green extension per detection on the running phase (ms)
+#define MAX_GREEN_TIME		40000		// Longest GREEN including extensions (ms)
+
+#ifndef BATCH_WINDOW_MAX_MS
+#define BATCH_WINDOW_MAX_MS	3000		// Longest wait for further calls before serving an idle intersection (ms, 0 = always immediate)
+#endif
+#define BATCH_IDLE_GAP_MS	10000		// Batching stops once the busiest lane's mean arrival gap reaches this (ms)
+
+/** @brief How actuated GREEN intervals ended */
+typedef struct {
+	uint32_t gapOut;		/**< No detection within PASSAGE_TIME */
+	uint32_t maxOut;		/**< Still extending when MAX_GREEN_TIME was reached */
+} ActuationStats;
 
-void checkGreenLightTimeout(void);
-void SysTick_CheckFirstPressTimeout(void);
-void changeLight(uint32_t lightA, uint32_t lightB);
+bool controller_idle(void);
+const char *controller_state_name(void);
+uint32_t controller_phase(void);
+bool controller_force_phase(uint32_t phase);
+void controller_set_trace(bool on);
+void controller_stop(void);
+const ActuationStats *controller_get_actuation_stats(void);
+void controller_process_events(void);
 
 #endif /* CONTROLLER_H_ */
\ No newline at end of file
@@ -0,0 +1,29 @@
+/**
+ * @file debounce.h
+ * @brief Public API for the sampled detector debounce filter.
+*/
+
+#ifndef DEBOUNCE_H_
+#define DEBOUNCE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32f446xx.h"
+
+/** @brief Period at which the detector inputs are sampled while any of them is changing (ms) */
+#define DEBOUNCE_SAMPLE_MS		5
+
+/** @brief Consecutive equal samples needed to accept a change, unless set per lane */
+#define DEBOUNCE_SAMPLES		4
+
+/** @brief Largest per-lane sample count (3-bit vertical counter) */
+#define DEBOUNCE_SAMPLES_MAX	8
+
+// Function Prototypes
+void debounce_init(void);
+void debounce_set_samples(uint32_t lane, uint32_t samples);
+uint32_t debounce_state(void);
+bool debounce_busy(void);
+void EXTI15_10_IRQHandler(void);
+
+#endif /* DEBOUNCE_H_ */
@@ -0,0 +1,38 @@
+/**
+ * @file estimator.h
+ * @brief Public API for the per-lane arrival-rate and queue estimator.
+*/
+
+#ifndef ESTIMATOR_H_
+#define ESTIMATOR_H_
+
+#include <stdint.h>
+#include "lights.h"
+
+/** @brief Green time bounds and per-vehicle extension (milliseconds) */
+#define GREEN_MIN_MS		2000
+#define GREEN_MAX_MS		20000
+#define GREEN_STARTUP_MS	1000		/**< Start-up lost time of a queue */
+#define GREEN_EXTENSION_MS	2000		/**< Green added per queued vehicle (saturation headway) */
+
+/** @brief EWMA weight as a shift: new = old + (sample - old) / 2^EWMA_SHIFT */
+#define EWMA_SHIFT			3
+
+/** @brief Longest inter-arrival gap fed to the rate estimate (idle lanes saturate here) */
+#define ARRIVAL_GAP_MAX_MS	60000
+
+/** @brief Detector occupancy (percent of the cycle) of moving traffic - no effect up to here */
+#define OCCUPANCY_FREE		10
+
+/** @brief Detector occupancy (percent of the cycle) at which a lane counts as congested */
+#define OCCUPANCY_CONGESTED	30
+
+// Function Prototypes
+void estimator_arrival(TrafficLight *light, uint32_t now);
+void estimator_departure(TrafficLight *light, uint32_t now);
+void estimator_served(TrafficLight *light, uint32_t now);
+uint32_t estimator_occupancy(const TrafficLight *light, uint32_t now);
+uint32_t estimator_green_time(const TrafficLight *light, uint32_t now);
+uint32_t estimator_gap_ms(const TrafficLight *light);
+
+#endif /* ESTIMATOR_H_ */
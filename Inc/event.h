@@ -0,0 +1,50 @@
+/**
+ * @file event.h
+ * @brief Public API for the interrupt-to-main-loop event queue.
+*/
+
+#ifndef EVENT_H_
+#define EVENT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ring.h"
+
+/** @brief Capacity of the event queue (must be a power of two) */
+#define EVENT_QUEUE_SIZE		32
+
+/** @brief Kinds of events captured by interrupt handlers */
+typedef enum {
+	EVENT_VEHICLE_DETECTED,		/**< Debounced detector press, id = lane index */
+	EVENT_VEHICLE_RELEASED,		/**< Debounced detector release, id = lane index, value = occupied time (us) */
+	EVENT_TIMER_EXPIRED,		/**< Software timer expired, id = timer id, value = timer generation */
+	EVENT_PHASE_FORCED			/**< Console forced a phase, id = phase index */
+} EventType;
+
+/** @brief Timestamped event record */
+typedef struct {
+	uint8_t type;				/**< EventType */
+	uint8_t id;					/**< Lane, timer or phase index */
+	uint32_t value;				/**< Event-specific value (see EventType) */
+	uint64_t timestamp;			/**< Capture time in microseconds (systickGetMicros()) */
+} Event;
+
+/**
+ * @brief Lock-free multi-producer/single-consumer event ring.
+ *
+ * Every interrupt handler pushes into the same ring, so the main loop
+ * receives events in capture order without merging queues.
+*/
+RING_MPSC_DEFINE(EventQueue, event_ring, Event, EVENT_QUEUE_SIZE)
+
+/** @brief Events produced by the detector debounce filter, TIM2_IRQHandler (timer callbacks) and the console */
+extern EventQueue controllerEvents;
+
+// Function Prototypes
+bool event_push(EventType type, uint8_t id, uint64_t timestamp);
+bool event_push_value(EventType type, uint8_t id, uint64_t timestamp, uint32_t value);
+bool event_pop(Event *ev);
+bool event_pending(void);
+uint32_t event_dropped(void);
+
+#endif /* EVENT_H_ */
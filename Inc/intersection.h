@@ -0,0 +1,81 @@
+/**
+ * @file intersection.h
+ * @brief Intersection layout: signal phases, their detectors and conflicts.
+ *
+ * A phase is a set of signal heads that may show GREEN together. Each phase
+ * lists its lights and the detector inputs that call it as bitmasks (bit n =
+ * `Light[n]` / detector n). Two phases conflict when their movements cross;
+ * conflicting phases are never GREEN at the same time.
+ *
+ * To describe a different intersection, edit NUM_PHASES and the tables in
+ * intersection.c - the controller itself has no per-phase code.
+*/
+
+#ifndef INTERSECTION_H_
+#define INTERSECTION_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** @brief Number of signal phases in the phase table */
+#define NUM_PHASES			2
+
+/** @brief Phase shown GREEN at power-up */
+#define INITIAL_PHASE		0
+
+/**
+ * @brief Change interval parameters (ITE kinematic model, level approach).
+ *
+ * YELLOW = reaction time + v / 2a, all-red = (width + vehicle length) / v,
+ * both rounded up to CLEAR_ROUND_MS.
+*/
+#define CLEAR_REACTION_MS		1000		// Driver perception-reaction time (ms)
+#define CLEAR_DECEL_MM_S2		3050		// Comfortable deceleration (mm/s^2)
+#define CLEAR_VEHICLE_M			6			// Vehicle length (m)
+#define CLEAR_ROUND_MS			100
+
+/** @brief One signal phase */
+typedef struct {
+	const char *name;		/**< Name used in log messages */
+	uint32_t lights;		/**< Bitmask of Light[] indices shown GREEN by the phase */
+	uint32_t detectors;		/**< Bitmask of detector inputs that call the phase */
+	uint32_t weight;		/**< Share of service under the weighted fair policy */
+	uint32_t speed;			/**< Approach speed (km/h) - sets the YELLOW of the phase's lights */
+	uint32_t width;			/**< Distance from the stop line past the conflicting flow (m) - sets the all-red */
+} Phase;
+
+/** @brief Change interval of the lights of a phase when they are stopped (ms) */
+typedef struct {
+	uint32_t yellow;
+	uint32_t allRed;
+} Clearance;
+
+/** @brief Phase table */
+extern const Phase PHASES[NUM_PHASES];
+
+/** @brief Conflict matrix - bit q of row p is set if phases p and q conflict */
+extern const uint32_t PHASE_CONFLICTS[NUM_PHASES];
+
+/**
+ * @brief Permissive matrix of the conflict monitor - bit j of row i is set if lights i
+ * 		  and j may show GREEN or YELLOW together.
+ *
+ * Kept separate from the phase table on purpose, like the programming card of
+ * a cabinet's conflict monitor: intersection_init() only checks that every
+ * phase is permitted by it.
+*/
+extern const uint32_t LIGHT_COMPATIBLE[];
+
+/** @brief Light each detector input sits in front of (for car counts) */
+extern const uint8_t DETECTOR_LIGHT[];
+
+/** @brief Consecutive samples each detector needs to accept a change (see debounce.h) */
+extern const uint8_t DETECTOR_DEBOUNCE[];
+
+// Function Prototypes
+bool intersection_init(void);
+uint32_t intersection_detector_phases(uint32_t detector);
+uint32_t intersection_conflict_lights(uint32_t phase);
+Clearance intersection_clearance(uint32_t lights);
+
+#endif /* INTERSECTION_H_ */
@@ -0,0 +1,97 @@
+/**
+ * @file latency.h
+ * @brief Built-in interrupt latency and timer jitter test mode.
+ *
+ * Built with LATENCY_TEST defined (`make LATENCY=1`, or `make latency` for
+ * the host simulation), the firmware measures its own response times:
+ * 	- LAT_EXTI: detector edge to EXTI15_10_IRQHandler() entry.
+ * 	- LAT_RESPONSE: detector edge to the first light output change it
+ * 	  causes in lights_commit() - debounce, event queue, control logic.
+ * 	- LAT_TIMER: software timer deadline to callback (TIM2 compare
+ * 	  delivery jitter, the tickless stand-in for a periodic tick).
+ *
+ * Edges are generated by the firmware itself. Spare open-drain outputs
+ * PC8, PC9 are wired to detectors 1 and 2 (PC10, PC11); the host
+ * simulation models the wires. While the intersection is idle the test
+ * driver pulls low the one whose light is RED, so every edge calls a new
+ * phase and the lights respond at once.
+ *
+ * Samples go into per-channel histograms. Every LATENCY_REPORT_RUNS edges
+ * the main loop logs n, p50, p99 and max per channel and whether the p99
+ * stays within the channel's limit - blocking work in an interrupt handler
+ * shows up as a FAIL. Without LATENCY_TEST every macro expands to nothing.
+*/
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32f446xx.h"
+#include "debounce.h"
+
+/** @brief First spare output - output LATENCY_LOOP_SHIFT + n is wired to detector n */
+#define LATENCY_LOOP_SHIFT		8
+
+/** @brief Looped-back detectors, one per phase of the default phase table */
+#define LATENCY_LANES			2
+
+#define LATENCY_PERIOD_MS		6000		// Pause between edges - keeps the call batching window at zero
+#define LATENCY_RETRY_MS		250			// Next idle check while the intersection is busy
+#define LATENCY_TIMEOUT_MS		5000		// Release an edge that got no response
+#define LATENCY_REPORT_RUNS		100			// Edges between two reports
+
+/** @brief Histogram bins per channel - bin width is set per channel, the last bin saturates */
+#define LATENCY_HIST_BINS		64
+
+/** @brief p99 limits (µs) - the response includes the debounce time of the lane */
+#define LATENCY_LIMIT_EXTI_US		20
+#define LATENCY_LIMIT_RESPONSE_US	((DEBOUNCE_SAMPLES * DEBOUNCE_SAMPLE_MS + 5) * 1000)
+#define LATENCY_LIMIT_TIMER_US		50
+
+/** @brief Measured paths */
+typedef enum {
+	LAT_EXTI,				/**< Edge to EXTI handler entry */
+	LAT_RESPONSE,			/**< Edge to first light output change */
+	LAT_TIMER,				/**< Timer deadline to callback */
+	LAT_CHANNELS
+} LatencyChannel;
+
+/** @brief Samples of one channel (µs) */
+typedef struct {
+	uint32_t count;
+	uint32_t max;
+	uint32_t hist[LATENCY_HIST_BINS];
+} LatencyStats;
+
+#ifdef LATENCY_TEST
+
+#define LATENCY_EXTI(now)		latency_exti(now)
+#define LATENCY_LIGHTS(lit)		latency_lights(lit)
+#define LATENCY_TIMER(late)		latency_record(LAT_TIMER, (late))
+#define LATENCY_INIT()			latency_init()
+#define LATENCY_POLL()			latency_poll()
+
+// Function Prototypes
+void latency_init(void);
+void latency_poll(void);
+void latency_exti(uint64_t now);
+void latency_lights(uint32_t lit);
+void latency_record(LatencyChannel channel, uint32_t us);
+const LatencyStats *latency_stats(LatencyChannel channel);
+uint32_t latency_percentile(LatencyChannel channel, uint32_t permille);
+uint32_t latency_limit(LatencyChannel channel);
+uint32_t latency_timeouts(void);
+bool latency_report(void);
+
+#else
+
+#define LATENCY_EXTI(now)		do { } while (0)
+#define LATENCY_LIGHTS(lit)		do { } while (0)
+#define LATENCY_TIMER(late)		do { } while (0)
+#define LATENCY_INIT()			do { } while (0)
+#define LATENCY_POLL()			do { } while (0)
+
+#endif /* LATENCY_TEST */
+
+#endif /* LATENCY_H_ */
@@ -8,19 +8,10 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "pinmap.h"
 
-/** @brief GPIO pin assignments for traffic light lEDs */
-#define PIN_LIGHT1_RED		10
-#define PIN_LIGHT1_GREEN	4    
-#define PIN_LIGHT2_RED      5
-#define PIN_LIGHT2_GREEN	3
-#define PIN_LIGHT3_RED      2
-#define PIN_LIGHT3_GREEN	1
-#define PIN_LIGHT4_RED      14
-#define PIN_LIGHT4_GREEN	13
-
-/** @brief Total number of traffic light in the system */
-#define NUM_LIGHTS			4
+/** @brief Total number of traffic light in the system (see pinmap.h) */
+#define NUM_LIGHTS			PINMAP_NUM_LIGHTS
 
 /** @brief Enumeration of possible traffic light states */
 typedef enum {
@@ -34,9 +25,15 @@ typedef enum {
 typedef struct {
 	LightState state;    	/**< Current state of the light */
 	int carCount;        	/**< Number of cars detected */
-	int redPin;          	/**< GPIO pin for RED LED */
-	int greenPin;        	/**< GPIO pin for GREEN LED */
+	uint32_t occupiedMs;	/**< Detector occupied time in the current cycle (ms) */
 	uint32_t timerEnd;  	/**< Timer based on car count */
+	uint32_t lastArrival;	/**< Time of the last detection (ms) */
+	uint32_t gapAvg;		/**< EWMA inter-arrival gap, ms in Q4 fixed point (0 = no data) */
+	uint32_t queueAvg;		/**< EWMA queue released per GREEN, vehicles in Q8 fixed point */
+	uint32_t occupiedSince;	/**< Start of the detector presence still being timed (ms) */
+	bool occupied;			/**< Detector currently occupied */
+	uint32_t cycleStart;	/**< Start of the current cycle - the light's last GREEN (ms) */
+	uint32_t occupancyAvg;	/**< EWMA detector occupancy per cycle, ratio in Q8 (256 = 100 %) */
 } TrafficLight;
 
 /** @brief Global array of traffic light instances */
@@ -44,10 +41,11 @@ extern TrafficLight Light[NUM_LIGHTS];
 
 // Function Prototypes
 void map_lights(void);
-void lights_update(const TrafficLight *light);
-void lights_set_green(int lightNum1, int lightNum2);
-uint32_t lights_set_yellow(int lightNum1, int lightNum2);
-uint32_t lights_set_red(int lightNum1, int lightNum2);
+void lights_commit(uint32_t lights);
+void lights_set_green(uint32_t lights);
+uint32_t lights_set_yellow(uint32_t lights);
+uint32_t lights_set_red(uint32_t lights);
+void lights_set_phase(uint32_t stop, uint32_t go);
 void lights_set_initial_state(void);
 void lights_init(void);
 
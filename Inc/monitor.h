@@ -0,0 +1,58 @@
+/**
+ * @file monitor.h
+ * @brief Conflict monitor - independent check of every light output write.
+ *
+ * Like the malfunction management unit of a real cabinet, the monitor does
+ * not trust the controller. lights_commit() hands it each GPIOB BSRR word
+ * before the store; the monitor decodes the head indications that word
+ * would produce and rejects it when:
+ * 	- two lights not permitted by LIGHT_COMPATIBLE (intersection.c) would
+ * 	  show anything but RED at the same time,
+ * 	- a head leaves GREEN without YELLOW, or goes RED -> YELLOW, YELLOW ->
+ * 	  GREEN or dark,
+ * 	- YELLOW ends before MONITOR_YELLOW_MIN_MS,
+ * 	- a head turns GREEN before every conflicting head has been RED for
+ * 	  MONITOR_ALL_RED_MS.
+ *
+ * A rejected write latches a fault: the store is dropped, all heads flash
+ * RED every MONITOR_FLASH_MS and further writes are refused until reset.
+ * The check is one mask test per lit head plus one pass over the heads,
+ * so it stays enabled in every build. monitor_fail_safe() latches the same flash for
+ * faults found outside the output path, such as a bad phase table.
+*/
+
+#ifndef MONITOR_H_
+#define MONITOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MONITOR_YELLOW_MIN_MS	1000		// Shortest YELLOW accepted before RED (ms)
+#define MONITOR_ALL_RED_MS		1000		// RED all conflicting heads must have shown before a GREEN (ms)
+#define MONITOR_FLASH_MS		500			// Half period of the fault flash (ms)
+
+/** @brief Why the monitor latched */
+typedef enum {
+	MONITOR_OK,				/**< No fault */
+	MONITOR_CONFLICT,		/**< Incompatible lights not RED together */
+	MONITOR_SEQUENCE,		/**< Illegal indication change */
+	MONITOR_YELLOW_SHORT,	/**< YELLOW shorter than MONITOR_YELLOW_MIN_MS */
+	MONITOR_ALL_RED_SHORT,	/**< GREEN before the conflicting heads cleared */
+	MONITOR_PHASE_TABLE		/**< Phase table failed validation at start-up */
+} MonitorFault;
+
+/** @brief Latched fault record */
+typedef struct {
+	MonitorFault fault;		/**< MONITOR_OK while running normally */
+	uint32_t light;			/**< Light index that tripped the monitor */
+	uint64_t time;			/**< Time of the rejected write (µs) */
+} MonitorStatus;
+
+// Function Prototypes
+void monitor_init(void);
+bool monitor_check(uint32_t bsrr);
+void monitor_fail_safe(MonitorFault fault);
+const MonitorStatus *monitor_status(void);
+const char *monitor_fault_name(MonitorFault fault);
+
+#endif /* MONITOR_H_ */
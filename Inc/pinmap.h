@@ -0,0 +1,69 @@
+/**
+ * @file pinmap.h
+ * @brief Board pin map - the one description of the signal head and detector wiring.
+ *
+ * Every light and detector is one entry of an X-macro list. The counts,
+ * pin masks and register values derived from the lists are constant
+ * expressions, so lights_init() and exti_init() write each configuration
+ * register once with a precomputed value, and the BSRR table of lights.c
+ * is expanded from the same list. Adding a lane is a line here plus its
+ * entries in the intersection tables (intersection.c).
+ *
+ * 	- Signal heads are on GPIOB, push-pull outputs, LEDs active low.
+ * 	- Detectors are on GPIOC, inputs with pull-up, active low, on
+ * 	  contiguous pins within EXTI lines 10-15 (EXTI15_10_IRQHandler).
+*/
+
+#ifndef PINMAP_H_
+#define PINMAP_H_
+
+#include <stdint.h>
+
+/** @brief Signal heads: X(red pin, green pin) on GPIOB, light 1 first */
+#define PINMAP_LIGHTS(X)			\
+	X(10, 4)						\
+	X(5,  3)						\
+	X(2,  1)						\
+	X(14, 13)
+
+/** @brief Detectors: X(pin) on GPIOC, lane 1 first */
+#define PINMAP_DETECTORS(X)			\
+	X(10)							\
+	X(11)							\
+	X(12)							\
+	X(13)
+
+/** @brief SYSCFG EXTICR port code of the detector port (0 = A, 1 = B, 2 = C) */
+#define PINMAP_DETECTOR_PORT		2U
+
+// Entry expanders
+#define PINMAP_COUNT_LIGHT(red, green)		+ 1
+#define PINMAP_COUNT_DETECTOR(pin)			+ 1
+#define PINMAP_LIGHT_BITS(red, green)		| (1U << (red)) | (1U << (green))
+#define PINMAP_DETECTOR_BIT(pin)			| (1U << (pin))
+
+#define PINMAP_NUM_LIGHTS			(0 PINMAP_LIGHTS(PINMAP_COUNT_LIGHT))
+#define PINMAP_NUM_DETECTORS		(0 PINMAP_DETECTORS(PINMAP_COUNT_DETECTOR))
+#define PINMAP_LIGHT_PINS			(0U PINMAP_LIGHTS(PINMAP_LIGHT_BITS))		// GPIOB
+#define PINMAP_DETECTOR_PINS		(0U PINMAP_DETECTORS(PINMAP_DETECTOR_BIT))	// GPIOC
+
+/** @brief GPIO MODER/PUPDR values (2 bits per pin) */
+#define GPIO_MODE_INPUT				0U
+#define GPIO_MODE_OUTPUT			1U
+#define GPIO_PULL_UP				1U
+
+/** @brief `value` in the 2-bit field of every pin set in `pins` (MODER, PUPDR...) */
+#define PINMAP_FIELD2(pins, value)	\
+	(PINMAP_F2(pins, value, 0)  | PINMAP_F2(pins, value, 1)  | PINMAP_F2(pins, value, 2)  | PINMAP_F2(pins, value, 3)  | \
+	 PINMAP_F2(pins, value, 4)  | PINMAP_F2(pins, value, 5)  | PINMAP_F2(pins, value, 6)  | PINMAP_F2(pins, value, 7)  | \
+	 PINMAP_F2(pins, value, 8)  | PINMAP_F2(pins, value, 9)  | PINMAP_F2(pins, value, 10) | PINMAP_F2(pins, value, 11) | \
+	 PINMAP_F2(pins, value, 12) | PINMAP_F2(pins, value, 13) | PINMAP_F2(pins, value, 14) | PINMAP_F2(pins, value, 15))
+#define PINMAP_F2(pins, value, n)	((((pins) >> (n)) & 1U) * ((uint32_t)(value) << (2 * (n))))
+
+/** @brief `value` in the 4-bit field of every line set in `pins` that SYSCFG EXTICR[reg] routes */
+#define PINMAP_EXTICR(pins, reg, value)	\
+	(PINMAP_F4(pins, reg, value, 0) | PINMAP_F4(pins, reg, value, 1) | \
+	 PINMAP_F4(pins, reg, value, 2) | PINMAP_F4(pins, reg, value, 3))
+#define PINMAP_F4(pins, reg, value, n)	((((pins) >> (4 * (reg) + (n))) & 1U) * ((uint32_t)(value) << (4 * (n))))
+
+#endif /* PINMAP_H_ */
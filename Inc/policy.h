@@ -0,0 +1,43 @@
+/**
+ * @file policy.h
+ * @brief Phase selection policies - which waiting phase gets GREEN next.
+ *
+ * The controller keeps the set of waiting phases; a policy only ranks
+ * them. The policy is chosen at build time with PHASE_POLICY (`make
+ * POLICY=fifo|lqf|pressure|wfq`). Whatever the policy, a phase that has
+ * waited longer than MAX_PHASE_WAIT_MS is served first.
+*/
+
+#ifndef POLICY_H_
+#define POLICY_H_
+
+#include <stdint.h>
+
+/** @brief PHASE_POLICY values */
+#define PHASE_POLICY_FIFO		0		/**< First called, first served */
+#define PHASE_POLICY_LQF		1		/**< Longest single-lane queue first */
+#define PHASE_POLICY_PRESSURE	2		/**< Max-pressure: largest total queue released */
+#define PHASE_POLICY_WFQ		3		/**< Weighted fair (stride) by Phase.weight */
+
+#ifndef PHASE_POLICY
+#define PHASE_POLICY			PHASE_POLICY_FIFO
+#endif
+
+/** @brief Starvation bound applied on top of every policy */
+#define MAX_PHASE_WAIT_MS		120000
+
+/** @brief Phase selection policy interface */
+typedef struct {
+	const char *name;
+	/** Phase entered the waiting set at `now` */
+	void (*enqueue)(uint32_t phase, uint32_t now);
+	/** Pick one phase of the non-empty `waiting` bitmask - no side effects */
+	uint32_t (*select)(uint32_t waiting, uint32_t now);
+	/** Phase left the waiting set for GREEN, picked by select(), a force or the starvation bound */
+	void (*served)(uint32_t phase, uint32_t now);
+} PhasePolicy;
+
+/** @brief Policy selected at build time */
+extern const PhasePolicy *const phasePolicy;
+
+#endif /* POLICY_H_ */
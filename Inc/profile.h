@@ -0,0 +1,101 @@
+/**
+ * @file profile.h
+ * @brief Cycle-count profiling of interrupt handlers and other hot paths.
+ *
+ * Built with PROFILE defined (`make PROFILE=1`), each instrumented region
+ * records its call count, min/max/total cycles and a log2 histogram into
+ * `profileStats`. The block sits at the fixed address PROFILE_STATS_ADDR
+ * (`.profile` section, see the linker scripts) so the debugger can read
+ * it without symbols; `gdb_commands.gdb` defines `profile` and
+ * `profile-dump`. Without PROFILE every macro expands to nothing.
+ *
+ * On the target cycles come from the DWT cycle counter. The host
+ * simulation models DWT->CYCCNT on the host's time stamp counter, so the
+ * same counts are host ticks there.
+ *
+ * Usage:
+ * @code
+ * 	void TIM2_IRQHandler(void) {
+ * 		PROFILE_BEGIN(PROF_TIM2);
+ * 		...
+ * 		PROFILE_END(PROF_TIM2);
+ * 	}
+ * @endcode
+*/
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+/** @brief Address of the stats block - must match the PROF region of the linker scripts */
+#define PROFILE_STATS_ADDR		0x2001FC00
+
+/** @brief `ProfileStats.magic` once profile_init() has run ("PROF") */
+#define PROFILE_MAGIC			0x464F5250
+
+/** @brief Histogram bins - bin n counts regions of 2^n to 2^(n+1)-1 cycles, the last one saturates */
+#define PROFILE_HIST_BINS		16
+
+/** @brief Instrumented regions */
+typedef enum {
+	PROF_EXTI,				/**< EXTI15_10_IRQHandler - detector edge */
+	PROF_TIM2,				/**< TIM2_IRQHandler - software timer expiry */
+	PROF_DMA,				/**< DMA1_Stream6_IRQHandler - log transfer complete */
+	PROF_EVENTS,			/**< controller_process_events - one main loop pass */
+	PROF_CHANGE_PHASE,		/**< changePhase */
+	PROF_LIGHTS_COMMIT,		/**< lights_commit - one output write */
+	PROF_CONFIG_LOAD,		/**< config_init - boot load of the parameter store */
+	PROF_REGIONS
+} ProfileRegion;
+
+/** @brief Statistics of one region */
+typedef struct {
+	uint32_t calls;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;						/**< Sum of all samples, mean = total / calls */
+	uint32_t hist[PROFILE_HIST_BINS];
+} ProfileRegionStats;
+
+/** @brief Stats block at PROFILE_STATS_ADDR */
+typedef struct {
+	uint32_t magic;						/**< PROFILE_MAGIC when valid */
+	uint32_t regions;					/**< Number of entries in `region` */
+	volatile uint32_t dumpRequest;		/**< Set non-zero to have the main loop dump over UART */
+	uint32_t reserved;
+	ProfileRegionStats region[PROF_REGIONS];
+} ProfileStats;
+
+#ifdef PROFILE
+
+extern ProfileStats profileStats;
+
+/** @brief Current cycle count */
+static inline uint32_t profile_cycles(void) {
+	return DWT->CYCCNT;
+}
+
+#define PROFILE_BEGIN(region)	uint32_t profStart_##region = profile_cycles()
+#define PROFILE_END(region)		profile_record((region), profile_cycles() - profStart_##region)
+#define PROFILE_INIT()			profile_init()
+#define PROFILE_POLL()			profile_poll()
+
+// Function Prototypes
+void profile_init(void);
+void profile_record(ProfileRegion region, uint32_t cycles);
+void profile_reset(void);
+void profile_dump(void);
+void profile_poll(void);
+
+#else
+
+#define PROFILE_BEGIN(region)	do { } while (0)
+#define PROFILE_END(region)		do { } while (0)
+#define PROFILE_INIT()			do { } while (0)
+#define PROFILE_POLL()			do { } while (0)
+
+#endif /* PROFILE */
+
+#endif /* PROFILE_H_ */
@@ -0,0 +1,186 @@
+/**
+ * @file ring.h
+ * @brief Generic bounded lock-free ring buffers.
+ *
+ * C has no templates, so each macro below expands to a ring type plus a
+ * set of `static inline` functions for one element type and capacity.
+ * Every ring is a separate instance; define as many as needed.
+ *
+ * 	- RING_SPSC_DEFINE: one producer and one consumer context (e.g. one ISR
+ * 	  and the main loop). Plain loads/stores with barriers, no atomics.
+ * 	- RING_MPSC_DEFINE: any number of producers (ISRs of any priority and the
+ * 	  main loop) and one consumer. Producers claim a slot with LDREX/STREX;
+ * 	  a per-slot lap stamp tells the consumer when the slot is filled.
+ *
+ * The capacity must be a power of two so indices wrap with a mask instead
+ * of a divide. Indices run freely and wrap at 2^32. A full ring rejects
+ * the new element with RING_FULL and counts it in `dropped`. `make ringtest`
+ * checks both variants on the host, including preempted MPSC producers.
+ *
+ * Usage:
+ * @code
+ * 	RING_SPSC_DEFINE(ByteRing, byte_ring, uint8_t, 64)
+ * 	static ByteRing rx;
+ * 	if (byte_ring_push(&rx, &b) != RING_OK) { ... }
+ * @endcode
+*/
+
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32f446xx.h"
+
+/** @brief Result of a ring operation */
+typedef enum {
+	RING_OK = 0,		/**< Element stored or returned */
+	RING_FULL,			/**< No free slot - element dropped */
+	RING_EMPTY			/**< Nothing to return */
+} RingStatus;
+
+/** @brief Atomically increment a counter shared by several interrupt levels */
+static inline void ring_atomic_inc(volatile uint32_t *counter) {
+	uint32_t value;
+	do {
+		value = __LDREXW(counter) + 1U;
+	} while (__STREXW(value, counter) != 0U);
+}
+
+/**
+ * @brief Define a single-producer/single-consumer ring.
+ *
+ * `head` is written only by the producer and `tail` only by the consumer.
+ *
+ * @param type_		Name of the ring type
+ * @param prefix_	Prefix of the generated functions (prefix_push, ...)
+ * @param elem_		Element type
+ * @param size_		Capacity, a power of two
+*/
+#define RING_SPSC_DEFINE(type_, prefix_, elem_, size_)									\
+	_Static_assert(((size_) & ((size_) - 1U)) == 0U, #type_ " size must be a power of two");	\
+																						\
+	typedef struct {																	\
+		elem_ buf[size_];																\
+		volatile uint32_t head;			/* Next slot to write (producer) */				\
+		volatile uint32_t tail;			/* Next slot to read (consumer) */				\
+		volatile uint32_t dropped;		/* Elements lost because the ring was full */	\
+	} type_;																			\
+																						\
+	static inline RingStatus prefix_##_push(type_ *r, const elem_ *item) {				\
+		uint32_t head = r->head;														\
+		if (head - r->tail >= (size_)) {												\
+			r->dropped++;																\
+			return RING_FULL;															\
+		}																				\
+		r->buf[head & ((size_) - 1U)] = *item;											\
+		__DMB();						/* Publish the element before the index */		\
+		r->head = head + 1U;															\
+		return RING_OK;																	\
+	}																					\
+																						\
+	static inline const elem_ *prefix_##_peek(const type_ *r) {						\
+		uint32_t tail = r->tail;														\
+		if (tail == r->head) {															\
+			return 0;																	\
+		}																				\
+		__DMB();						/* Read the element after observing the index */	\
+		return &r->buf[tail & ((size_) - 1U)];											\
+	}																					\
+																						\
+	static inline RingStatus prefix_##_pop(type_ *r, elem_ *item) {					\
+		const elem_ *slot = prefix_##_peek(r);											\
+		if (!slot) {																	\
+			return RING_EMPTY;															\
+		}																				\
+		*item = *slot;																	\
+		__DMB();						/* Finish reading before releasing the slot */	\
+		r->tail = r->tail + 1U;															\
+		return RING_OK;																	\
+	}																					\
+																						\
+	static inline bool prefix_##_empty(const type_ *r) {								\
+		return r->tail == r->head;														\
+	}																					\
+																						\
+	static inline uint32_t prefix_##_count(const type_ *r) {							\
+		return r->head - r->tail;														\
+	}
+
+/**
+ * @brief Define a multi-producer/single-consumer ring.
+ *
+ * Each slot carries a stamp: `lap` when free for the producer of index
+ * `lap + n`, `lap + 1` once filled. Producers claim `head` with LDREX/STREX
+ * (an interrupt between the two makes the store fail and the claim retry),
+ * fill the slot, then set the stamp. The consumer only reads slots whose
+ * stamp says filled, so a producer preempted mid-write never exposes a
+ * partial element. A zero-initialized ring is empty.
+ *
+ * @param type_		Name of the ring type
+ * @param prefix_	Prefix of the generated functions (prefix_push, ...)
+ * @param elem_		Element type
+ * @param size_		Capacity, a power of two
+*/
+#define RING_MPSC_DEFINE(type_, prefix_, elem_, size_)									\
+	_Static_assert(((size_) & ((size_) - 1U)) == 0U, #type_ " size must be a power of two");	\
+																						\
+	typedef struct {																	\
+		struct {																		\
+			volatile uint32_t stamp;													\
+			elem_ item;																	\
+		} slot[size_];																	\
+		volatile uint32_t head;			/* Next index to claim (producers) */			\
+		volatile uint32_t tail;			/* Next index to read (consumer) */				\
+		volatile uint32_t dropped;		/* Elements lost because the ring was full */	\
+	} type_;																			\
+																						\
+	static inline RingStatus prefix_##_push(type_ *r, const elem_ *item) {				\
+		uint32_t pos, lap;																\
+		for (;;) {																		\
+			pos = __LDREXW(&r->head);													\
+			lap = pos & ~((size_) - 1U);												\
+			int32_t diff = (int32_t)(r->slot[pos & ((size_) - 1U)].stamp - lap);		\
+			if (diff < 0) {						/* Previous lap not read yet */		\
+				__CLREX();																\
+				ring_atomic_inc(&r->dropped);											\
+				return RING_FULL;														\
+			}																			\
+			if (diff == 0 && __STREXW(pos + 1U, &r->head) == 0U) {						\
+				break;																	\
+			}																			\
+			__CLREX();							/* Lost the race - reload head */		\
+		}																				\
+		r->slot[pos & ((size_) - 1U)].item = *item;										\
+		__DMB();						/* Publish the element before the stamp */		\
+		r->slot[pos & ((size_) - 1U)].stamp = lap + 1U;									\
+		return RING_OK;																	\
+	}																					\
+																						\
+	static inline const elem_ *prefix_##_peek(const type_ *r) {						\
+		uint32_t tail = r->tail;														\
+		if (r->slot[tail & ((size_) - 1U)].stamp != (tail & ~((size_) - 1U)) + 1U) {	\
+			return 0;																	\
+		}																				\
+		__DMB();						/* Read the element after observing the stamp */	\
+		return &r->slot[tail & ((size_) - 1U)].item;									\
+	}																					\
+																						\
+	static inline RingStatus prefix_##_pop(type_ *r, elem_ *item) {					\
+		const elem_ *slot = prefix_##_peek(r);											\
+		if (!slot) {																	\
+			return RING_EMPTY;															\
+		}																				\
+		uint32_t tail = r->tail;														\
+		*item = *slot;																	\
+		__DMB();						/* Finish reading before releasing the slot */	\
+		r->slot[tail & ((size_) - 1U)].stamp = (tail & ~((size_) - 1U)) + (size_);		\
+		r->tail = tail + 1U;															\
+		return RING_OK;																	\
+	}																					\
+																						\
+	static inline bool prefix_##_empty(const type_ *r) {								\
+		return prefix_##_peek(r) == 0;													\
+	}
+
+#endif /* RING_H_ */
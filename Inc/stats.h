@@ -0,0 +1,97 @@
+/**
+ * @file stats.h
+ * @brief Per-light traffic counters binned into a fixed time-series history.
+ *
+ * The controller reports detections, queued calls, released queues and
+ * GREEN terminations; each report adds to the current bin of every tier
+ * below, a constant number of stores. A tier is a ring of bins of one
+ * width; a bin that falls out of the ring is overwritten, so the memory
+ * use is fixed (STATS_TIERS x sizeof(StatsBin)). Tiers roll over lazily on
+ * the next report or export - no timer wakes the core for statistics.
+ *
+ * Each bin holds, per light, four 16-bit words (volume, served vehicles,
+ * their total wait, GREEN used and max queue packed together) plus the
+ * GREEN termination reasons of the bin. Counters saturate instead of
+ * wrapping.
+ *
+ * stats_export() streams every bin as a self-contained frame over USART2:
+ *
+ * 	STATS_FRAME_SYNC | minutes | lights | size | bin (u32) | StatsBin | fletcher16 (u16)
+ *
+ * Fields are little-endian. `bin` counts bins of `minutes` since boot, and
+ * the checksum covers every byte after the sync. A frame is always 8 + size
+ * + 2 bytes and is queued whole with one uart2_write_buf(), so a reader of
+ * the shared line that does not decode frames (`Tools/logdecode.py`) can
+ * skip one by its size byte even when the body holds LOG_RECORD_SYNC
+ * bytes. Frames are queued from
+ * the main loop (stats_poll()) only while the log ring keeps room for
+ * other messages; `Tools/statsdecode.py` prints them.
+*/
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lights.h"
+
+/** @brief History tiers: X(bin width in minutes, bins) - 1 h, 3 h and 24 h */
+#define STATS_TIERS(X)			\
+	X(1,	60)					\
+	X(5,	36)					\
+	X(15,	96)
+
+/** @brief Export frame start marker - distinct from LOG_RECORD_SYNC and from text */
+#define STATS_FRAME_SYNC		0xA6
+
+#define STATS_GREEN_MAX_S		0x3FFU		// GREEN used saturates at 10 bits (s)
+#define STATS_QUEUE_MAX			0x3FU		// Max queue saturates at 6 bits
+
+#define STATS_GREEN(gq)			((gq) & STATS_GREEN_MAX_S)
+#define STATS_QUEUE(gq)			((gq) >> 10)
+
+/** @brief Counters of one light in one bin */
+typedef struct {
+	uint16_t volume;		/**< Detections */
+	uint16_t served;		/**< Queued vehicles released by a GREEN */
+	uint16_t waitS;			/**< Total wait of the served vehicles, call to GREEN (s) */
+	uint16_t greenQueue;	/**< GREEN used (s, bits 0-9) | max queue (bits 10-15) */
+} StatsLane;
+
+/** @brief One bin of a tier */
+typedef struct {
+	StatsLane lane[NUM_LIGHTS];
+	uint8_t gapOuts;		/**< GREEN ended with no detection within the passage time */
+	uint8_t maxOuts;		/**< GREEN ended at the maximum */
+	uint8_t forced;			/**< GREEN ended early for a forced phase */
+	uint8_t reserved;
+} StatsBin;
+
+/** @brief Why a GREEN ended */
+typedef enum {
+	STATS_GAP_OUT,
+	STATS_MAX_OUT,
+	STATS_FORCED
+} StatsEnd;
+
+/** @brief Read-only view of one tier */
+typedef struct {
+	uint32_t minutes;		/**< Bin width */
+	uint32_t length;		/**< Bins in the ring */
+	uint32_t newest;		/**< Number of the current bin, counted since boot */
+	const StatsBin *bins;	/**< Ring - bin n is bins[n % length] */
+} StatsTier;
+
+#define STATS_TIER_COUNT(minutes, bins)		+ 1
+#define STATS_NUM_TIERS			(0 STATS_TIERS(STATS_TIER_COUNT))
+
+// Function Prototypes
+void stats_detection(uint32_t light, uint32_t now);
+void stats_queued(uint32_t light, uint32_t queue, uint32_t now);
+void stats_served(uint32_t light, uint32_t greenAt, uint32_t now);
+void stats_green_end(uint32_t lights, uint32_t greenMs, StatsEnd reason, uint32_t now);
+StatsTier stats_tier(uint32_t tier, uint32_t now);
+bool stats_export(uint32_t now);
+void stats_poll(void);
+
+#endif /* STATS_H_ */
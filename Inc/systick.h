@@ -1,17 +1,38 @@
-/**
- * @file systick.h
-  *@brief Public API for SysTick timer configuration and millisecond utilities.
-*/
-
-#ifndef SYSTICK_H_
-#define SYSTICK_H_
-
-#include "stm32f446xx.h"
-
-// Function Prototypes
-void SysTick_Handler(void);
-void systick_init(void);
-uint32_t systickGetMillis(void);
-void systickDelayMs(int delay);
-
-#endif /* SYSTICK_H_ */
+/**
+ * @file systick.h
+  *@brief Public API for the system time base and one-shot software timers.
+*/
+
+#ifndef SYSTICK_H_
+#define SYSTICK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32f446xx.h"
+
+/** @brief Longest software timer delay - deadlines are compared on the 32-bit microsecond counter */
+#define SOFT_TIMER_MAX_MS		2147483U
+
+/** @brief Callback invoked from the timer interrupt when a software timer expires */
+typedef void (*SoftTimerCallback)(void);
+
+/** @brief One-shot software timer multiplexed onto the TIM2 compare channel */
+typedef struct SoftTimer {
+	uint32_t deadline;				/**< Expiry time in TIM2 ticks (microseconds, wraps) */
+	SoftTimerCallback callback;		/**< Function called on expiry */
+	struct SoftTimer *next;			/**< Next armed timer (sorted by deadline) */
+	bool armed;						/**< Timer is in the armed list */
+} SoftTimer;
+
+// Function Prototypes
+void TIM2_IRQHandler(void);
+void systick_init(void);
+uint32_t systickGetMillis(void);
+uint64_t systickGetMicros(void);
+void systickDelayMs(int delay);
+void systick_timer_start(SoftTimer *timer, uint32_t delayMs);
+void systick_timer_stop(SoftTimer *timer);
+bool systick_timer_active(const SoftTimer *timer);
+uint32_t systick_get_wakeups(void);
+
+#endif /* SYSTICK_H_ */
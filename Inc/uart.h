@@ -7,13 +7,89 @@
 #define UART_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "stm32f446xx.h"
 
+/** @brief Maximum number of arguments of a deferred LOG() call */
+#define LOG_MAX_ARGS		6
+
+/** @brief Record start marker, never the first byte of a plain text line */
+#define LOG_RECORD_SYNC		0xA5
+
+#ifndef LOG_DEFERRED
+
 /** @brief Format for printf */
 #define LOG(fmt, ...)  printf( fmt "\n\r", ##__VA_ARGS__)
 
+#else
+
+/**
+ * @brief Deferred (tokenized) logging.
+ *
+ * The format string is placed in the non-loaded `.logfmt` section and only
+ * its address is sent, followed by the timestamp and the raw argument words.
+ * `Tools/logdecode.py` rebuilds the text from the ELF file on the host.
+ * Up to LOG_MAX_ARGS integer or string-literal arguments are supported.
+ * A `%s` argument is sent as its address, so it must point to rodata: text
+ * in RAM is overwritten before the host reads it. LOG_CAST() rejects a
+ * `char *` argument at compile time - string literals are `const` in this
+ * build (-Wwrite-strings) - and RAM text goes out through uart2_write_buf().
+*/
+#define LOG(fmt, ...)  do {																	\
+	static const char logFmt_[] __attribute__((section(".logfmt"), used)) = fmt;				\
+	const uint32_t logArgs_[] = { 0, LOG_MAP(LOG_NARGS(__VA_ARGS__), __VA_ARGS__) };		\
+	uart2_log_record(logFmt_, LOG_NARGS(__VA_ARGS__), &logArgs_[1]);						\
+} while (0)
+
+#define LOG_NARGS(...)		LOG_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, N, ...)	N
+
+#define LOG_CAST(x)			((uint32_t)(uintptr_t)_Generic((x), char *: log_ram_text_(), default: (x)))
+#define LOG_MAP(N, ...)		LOG_MAP_(N, __VA_ARGS__)
+#define LOG_MAP_(N, ...)	LOG_MAP##N(__VA_ARGS__)
+#define LOG_MAP0(...)
+#define LOG_MAP1(a)					LOG_CAST(a)
+#define LOG_MAP2(a, b)				LOG_CAST(a), LOG_CAST(b)
+#define LOG_MAP3(a, b, c)			LOG_MAP2(a, b), LOG_CAST(c)
+#define LOG_MAP4(a, b, c, d)		LOG_MAP3(a, b, c), LOG_CAST(d)
+#define LOG_MAP5(a, b, c, d, e)		LOG_MAP4(a, b, c, d), LOG_CAST(e)
+#define LOG_MAP6(a, b, c, d, e, f)	LOG_MAP5(a, b, c, d, e), LOG_CAST(f)
+
+uint32_t log_ram_text_(void) __attribute__((error("LOG() argument is writable text - send it with uart2_write_buf()")));
+
+#endif /* LOG_DEFERRED */
+
+/** @brief Size of the transmit log ring in bytes (must be a power of two) */
+#ifndef UART_LOG_BUF_SIZE
+#define UART_LOG_BUF_SIZE		1024
+#endif
+
+/** @brief Log ring overflow policies */
+#define LOG_OVERFLOW_DROP_NEWEST	0	/**< Discard the message that does not fit */
+#define LOG_OVERFLOW_DROP_OLDEST	1	/**< Discard the oldest whole records not yet handed to the DMA */
+#define LOG_OVERFLOW_REPORT			2	/**< Discard newest and report the loss once space frees up */
+
+/** @brief Overflow policy used by the log ring */
+#ifndef UART_LOG_OVERFLOW
+#define UART_LOG_OVERFLOW		LOG_OVERFLOW_REPORT
+#endif
+
+/** @brief Size of the receive ring in bytes (must be a power of two) */
+#ifndef UART_RX_BUF_SIZE
+#define UART_RX_BUF_SIZE		64
+#endif
+
 // Function Prototypes
 void uart2_init(void);
 void uart2_write(int ch);
+uint32_t uart2_write_buf(const char *buf, uint32_t len);
+uint32_t uart2_write_free(void);
+uint32_t uart2_log_dropped(void);
+void uart2_log_record(const char *fmt, uint32_t nargs, const uint32_t *args);
+bool uart2_read(uint8_t *byte);
+bool uart2_rx_pending(void);
+uint32_t uart2_rx_dropped(void);
+void DMA1_Stream6_IRQHandler(void);
+void USART2_IRQHandler(void);
 
 #endif /* UART_H_ */
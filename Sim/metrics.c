@@ -0,0 +1,226 @@
+/**
+ * @file metrics.c
+ * @brief Vehicle queue model and wait-time statistics for the simulation.
+ *
+ * Every arrival joins its lane's queue. While the lane's signal shows GREEN
+ * vehicles leave one per saturation headway; a vehicle arriving on GREEN
+ * with nobody ahead passes without waiting. YELLOW and RED stop departures.
+ *
+ * Waits are kept in a 100 ms histogram per lane so percentiles cost
+ * constant memory regardless of trace length. Queue lengths are integrated
+ * over time and optionally sampled to a CSV file.
+*/
+
+#include "metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LANES		16
+#define BIN_MS			100
+#define NUM_BINS		(3600 * 1000 / BIN_MS)		// Waits up to 1 hour, longer ones saturate
+
+typedef struct {
+	SimTime *fifo;					// Arrival times of queued vehicles (ring)
+	size_t cap, head, count;
+	bool green;
+	SimTime nextDeparture;			// SIM_NEVER while not GREEN
+
+	uint64_t arrivals, served;
+	double waitSumMs;
+	uint32_t waitMaxMs;
+	uint64_t *hist;
+
+	size_t maxQueue;
+	double queueIntegral;			// Vehicle-cycles, for the time average
+	SimTime lastChange;
+	double greenTime;				// Cycles spent GREEN
+	SimTime greenSince;
+	uint64_t greens;				// Number of GREEN intervals
+} Lane;
+
+static Lane lane[MAX_LANES];
+static int numLanes;
+static SimTime headway;
+static FILE *csv;
+static SimTime sampleEvery, nextSample = SIM_NEVER;
+
+static void queue_account(Lane *l, SimTime now) {
+	l->queueIntegral += (double)l->count * (double)(now - l->lastChange);
+	l->lastChange = now;
+}
+
+static void push(Lane *l, SimTime t) {
+	if (l->count == l->cap) {
+		size_t cap = l->cap ? l->cap * 2 : 64;
+		SimTime *fifo = malloc(cap * sizeof(*fifo));
+		for (size_t i = 0; i < l->count; i++) {
+			fifo[i] = l->fifo[(l->head + i) % l->cap];
+		}
+		free(l->fifo);
+		l->fifo = fifo;
+		l->cap = cap;
+		l->head = 0;
+	}
+	l->fifo[(l->head + l->count) % l->cap] = t;
+	l->count++;
+	if (l->count > l->maxQueue) {
+		l->maxQueue = l->count;
+	}
+}
+
+static void serve(Lane *l, SimTime arrival, SimTime now) {
+	uint32_t waitMs = (uint32_t)SIM_TO_MS(now - arrival);
+	uint32_t bin = waitMs / BIN_MS;
+	l->hist[bin < NUM_BINS ? bin : NUM_BINS - 1]++;
+	l->waitSumMs += waitMs;
+	if (waitMs > l->waitMaxMs) {
+		l->waitMaxMs = waitMs;
+	}
+	l->served++;
+}
+
+/**
+ * @brief Reset the model.
+ *
+ * @param lanes      Number of lanes (one signal head and detector each)
+ * @param headwayMs  Saturation headway between departing vehicles
+ * @param queueCsv   Optional file for periodic queue-length samples
+ * @param sampleMs   Sampling period for `queueCsv`
+*/
+void metrics_init(int lanes, uint32_t headwayMs, FILE *queueCsv, uint32_t sampleMs) {
+	numLanes = lanes < MAX_LANES ? lanes : MAX_LANES;
+	headway = SIM_MS(headwayMs);
+	for (int i = 0; i < numLanes; i++) {
+		memset(&lane[i], 0, sizeof(lane[i]));
+		lane[i].hist = calloc(NUM_BINS, sizeof(uint64_t));
+		lane[i].nextDeparture = SIM_NEVER;
+	}
+
+	csv = queueCsv;
+	if (csv) {
+		sampleEvery = SIM_MS(sampleMs);
+		nextSample = 0;
+		fprintf(csv, "time_s");
+		for (int i = 0; i < numLanes; i++) {
+			fprintf(csv, ",lane%d", i + 1);
+		}
+		fprintf(csv, "\n");
+	}
+}
+
+/** @brief A vehicle reached the stop line of `lane` */
+void metrics_arrival(int laneIdx, SimTime now) {
+	Lane *l = &lane[laneIdx];
+	l->arrivals++;
+
+	if (l->green && l->count == 0 && l->nextDeparture <= now) {
+		serve(l, now, now);						// Rolls through on GREEN
+		l->nextDeparture = now + headway;
+		return;
+	}
+	queue_account(l, now);
+	push(l, now);
+}
+
+/** @brief The signal of `lane` turned GREEN (true) or stopped showing GREEN */
+void metrics_green(int laneIdx, bool green, SimTime now) {
+	Lane *l = &lane[laneIdx];
+	if (green == l->green) {
+		return;
+	}
+	l->green = green;
+	if (green) {
+		l->greenSince = now;
+		l->greens++;
+		l->nextDeparture = now + headway;		// First vehicle clears one headway after GREEN
+	} else {
+		l->greenTime += (double)(now - l->greenSince);
+		l->nextDeparture = SIM_NEVER;
+	}
+}
+
+/** @brief Time of the next departure or queue sample */
+SimTime metrics_next_event(void) {
+	SimTime next = nextSample;
+	for (int i = 0; i < numLanes; i++) {
+		if (lane[i].count && lane[i].nextDeparture < next) {
+			next = lane[i].nextDeparture;
+		}
+	}
+	return next;
+}
+
+/** @brief Process departures and samples due at `now` */
+void metrics_fire(SimTime now) {
+	for (int i = 0; i < numLanes; i++) {
+		Lane *l = &lane[i];
+		if (l->count && l->nextDeparture <= now) {
+			queue_account(l, now);
+			serve(l, l->fifo[l->head], now);
+			l->head = (l->head + 1) % l->cap;
+			l->count--;
+			l->nextDeparture = now + headway;
+		}
+	}
+
+	if (csv && nextSample <= now) {
+		fprintf(csv, "%.0f", SIM_TO_MS(now) / 1000.0);
+		for (int i = 0; i < numLanes; i++) {
+			fprintf(csv, ",%zu", lane[i].count);
+		}
+		fprintf(csv, "\n");
+		nextSample += sampleEvery;
+	}
+}
+
+/** @brief Vehicles currently waiting on all lanes */
+size_t metrics_queued(void) {
+	size_t total = 0;
+	for (int i = 0; i < numLanes; i++) {
+		total += lane[i].count;
+	}
+	return total;
+}
+
+static double percentile(const Lane *l, double p) {
+	uint64_t target = (uint64_t)(p * (double)l->served);
+	uint64_t seen = 0;
+	for (uint32_t b = 0; b < NUM_BINS; b++) {
+		seen += l->hist[b];
+		if (seen > target) {
+			return (b + 1) * BIN_MS / 1000.0;
+		}
+	}
+	return NUM_BINS * BIN_MS / 1000.0;
+}
+
+/** @brief Print per-lane service and wait statistics */
+void metrics_report(FILE *out, SimTime end) {
+	uint64_t arrivals = 0, served = 0;
+	double waitSum = 0;
+
+	fprintf(out, "lane  arrivals    served  mean wait   p95 wait   p99 wait   max wait  max queue  avg queue  green %%  veh/green\n");
+	for (int i = 0; i < numLanes; i++) {
+		Lane *l = &lane[i];
+		queue_account(l, end);
+		if (l->green) {
+			l->greenTime += (double)(end - l->greenSince);
+			l->greenSince = end;
+		}
+		double mean = l->served ? l->waitSumMs / l->served / 1000.0 : 0;
+		fprintf(out, "%4d %9llu %9llu %9.2fs %9.1fs %9.1fs %9.1fs %10zu %10.2f %7.1f %10.2f\n",
+				i + 1, (unsigned long long)l->arrivals, (unsigned long long)l->served, mean,
+				percentile(l, 0.95), percentile(l, 0.99), l->waitMaxMs / 1000.0, l->maxQueue,
+				end ? l->queueIntegral / (double)end : 0, end ? 100.0 * l->greenTime / (double)end : 0,
+				l->greens ? (double)l->served / (double)l->greens : 0);
+		arrivals += l->arrivals;
+		served += l->served;
+		waitSum += l->waitSumMs;
+	}
+
+	double hours = (double)SIM_TO_MS(end) / 3600000.0;
+	fprintf(out, "all  %9llu %9llu %9.2fs   throughput %.0f veh/h\n",
+			(unsigned long long)arrivals, (unsigned long long)served,
+			served ? waitSum / served / 1000.0 : 0, hours > 0 ? served / hours : 0);
+}
@@ -0,0 +1,22 @@
+/**
+ * @file metrics.h
+ * @brief Vehicle queue model and wait-time statistics for the simulation.
+*/
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "sim.h"
+
+// Function Prototypes
+void metrics_init(int lanes, uint32_t headwayMs, FILE *queueCsv, uint32_t sampleMs);
+void metrics_arrival(int lane, SimTime now);
+void metrics_green(int lane, bool green, SimTime now);
+SimTime metrics_next_event(void);
+void metrics_fire(SimTime now);
+size_t metrics_queued(void);
+void metrics_report(FILE *out, SimTime end);
+
+#endif /* METRICS_H_ */
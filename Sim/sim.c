@@ -0,0 +1,626 @@
+/**
+ * @file sim.c
+ * @brief Register-level peripheral models and virtual time for the host build.
+ *
+ * Firmware code runs in zero virtual time; time only advances while the
+ * application sits in __WFI(). Interrupt handlers are invoked when their
+ * peripheral request line is active, the IRQ is enabled in the NVIC and
+ * PRIMASK is clear, exactly like on the target. All interrupts share one
+ * priority, so a handler is never preempted by another.
+ *
+ * Modelled behaviour:
+ * 	- GPIO: BSRR stores are applied to ODR and reported to a listener.
+ * 	- EXTI: edges on GPIOC inputs set PR according to RTSR/FTSR/IMR;
+ * 	  PR is write-1-to-clear.
+ * 	- TIM2: counter derived from virtual time (PSC/ARR), UG/CCxG events,
+ * 	  compare and update flags; SR is read/clear-by-writing-zero.
+ * 	- DMA1 Stream 6 + USART2 TX: a transfer takes 10 bit times per byte
+ * 	  at the programmed baud rate, then sets TCIF6.
+ * 	- USART2 RX: the harness delivers bytes with sim_uart_rx(), which sets
+ * 	  RXNE, or ORE if the previous byte is still unread. The model cannot
+ * 	  see a load of DR, so RXNE and ORE clear when USART2_IRQHandler()
+ * 	  returns - the firmware handler reads DR on every call.
+ * 	- FLASH: KEYR unlock sequence, LOCK, sector erase of either config
+ * 	  sector (BSY for SIM_FLASH_ERASE_MS) and word programming while PG is
+ * 	  set, which can only clear bits. Programming completes at once -
+ * 	  firmware busy-waits on BSY in zero virtual time.
+ * 	- Preemption: a test can run a handler inside firmware code at the next
+ * 	  barrier or exclusive store (simPreempt); the STREX after it fails.
+ * 	- DWT: firmware runs in zero virtual time, so CYCCNT counts host time
+ * 	  stamp counter ticks (nanoseconds where there is no TSC) instead,
+ * 	  which is what profiling firmware code on the host needs.
+*/
+
+#include "sim.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PR_SENTINEL			(1U<<31)	// Reserved EXTI bit, cleared by any write to PR
+#define EXTI_LINES_15_10	(0x3FU<<10)
+
+#define TIM_CR1_CEN			(1U<<0)
+#define TIM_EGR_UG			(1U<<0)
+#define TIM_SR_UIF			(1U<<0)
+#define TIM_IRQ_FLAGS		(0x5FU)		// UIF, CC1IF..CC4IF, TIF
+
+#define DMA_SCR_EN			(1U<<0)
+#define DMA_SCR_IRQ_EN		(0x1CU)		// TCIE, HTIE, TEIE
+#define DMA_HISR_TCIF6		(1U<<21)
+#define DMA_HISR_IRQ6		(0x3DU<<16)
+
+#define USART_CR1_UE		(1U<<13)
+#define USART_CR3_DMAT		(1U<<7)
+#define USART_IRQ_FLAGS		(0xF0U)		// TXE, TC, RXNE, IDLE
+#define USART_SR_IDLE_TX	((1U<<7) | (1U<<6))
+#define USART_SR_RXNE		(1U<<5)
+#define USART_SR_ORE		(1U<<3)
+#define USART_CR1_RE		(1U<<2)
+
+#define FLASH_KEY1			0x45670123U
+#define FLASH_KEY2			0xCDEF89ABU
+#define FLASH_SR_W1C		(0xF3U)		// EOP, OPERR, WRPERR, PGAERR, PGPERR, PGSERR
+#define FLASH_SR_PGSERR		(1U<<7)
+#define FLASH_SR_BSY		(1U<<16)
+#define FLASH_SR_SENTINEL	(1U<<31)	// Reserved SR bit, cleared by any write to SR
+#define FLASH_CR_PG			(1U<<0)
+#define FLASH_CR_SER		(1U<<1)
+#define FLASH_CR_SNB(cr)	(((cr) >> 3) & 0xFU)
+#define FLASH_CR_STRT		(1U<<16)
+#define FLASH_CR_LOCK		(1U<<31)
+
+#define SIM_CONFIG_SECTOR	6U			// First config sector, SIM_CONFIG_SECTORS in a row
+#define SIM_CONFIG_SECTORS	2U
+#define SIM_SECTOR_WORDS	(128U * 1024U / 4U)
+#define SIM_CONFIG_WORDS	(SIM_CONFIG_SECTORS * SIM_SECTOR_WORDS)
+#define SIM_FLASH_ERASE_MS	1000		// Typical 128 KB sector erase at x32 parallelism
+
+#define MAX_NESTED_IRQS		100000		// Handler calls in one dispatch before reporting a storm
+
+#define DEMCR_TRCENA		(1U<<24)
+#define DWT_CTRL_CYCCNTENA	(1U<<0)
+
+GPIO_TypeDef simGPIOA, simGPIOB, simGPIOC;
+RCC_TypeDef simRCC;
+EXTI_TypeDef simEXTI;
+SYSCFG_TypeDef simSYSCFG;
+USART_TypeDef simUSART2;
+DMA_TypeDef simDMA1;
+DMA_Stream_TypeDef simDMA1_Stream6;
+TIM_TypeDef simTIM2;
+FLASH_TypeDef simFLASH;
+SysTick_Type simSysTick;
+DWT_Type simDWT;
+CoreDebug_Type simCoreDebug;
+
+SimStats simStats;
+
+void (*simPreempt)(void) = NULL;
+uint32_t simPreemptSkip = 0;
+uint32_t simExclusive = 0;
+
+// Firmware interrupt handlers - weak so the harness links with any subset
+extern void EXTI15_10_IRQHandler(void) __attribute__((weak));
+extern void TIM2_IRQHandler(void) __attribute__((weak));
+extern void DMA1_Stream6_IRQHandler(void) __attribute__((weak));
+extern void USART2_IRQHandler(void) __attribute__((weak));
+
+/** @brief Shadow state the register blocks alone cannot hold */
+typedef struct {
+	TIM_TypeDef *regs;
+	SimTime base;			// Virtual time at which the unwrapped count was 0
+	uint32_t psc;			// Active prescaler (loaded on update event)
+	uint32_t cnt;			// CNT value exposed at the last sync
+	uint32_t sr;			// SR value exposed at the last sync
+} SimTimer;
+
+static SimTime now = 0;
+static SimTime endTime = SIM_NEVER;
+static jmp_buf endJump;
+static const SimInput *input = NULL;
+
+static uint32_t primask = 0;
+static bool inHandler = false;
+static bool nvicEnabled[SIM_NUM_IRQn];
+
+static uint32_t extiPending = 0;
+static uint32_t odrSeen[3];
+
+static SimTimer tim2 = { &simTIM2, 0, 0, 0, 0 };
+
+static bool dmaActive = false;
+static SimTime dmaDone = SIM_NEVER;
+
+uint32_t _sconfig[SIM_CONFIG_WORDS];		// Config sectors as the firmware reads them (CONFIG region)
+static uint32_t flashCells[SIM_CONFIG_WORDS];	// Programmed contents - stores only take effect while PG is set
+static uint32_t flashSr;					// SR flags other than BSY
+static bool flashKey1 = false;				// First unlock key seen
+static bool flashLocked = true;
+static SimTime flashBusyUntil = 0;
+
+static uint64_t dwtBase;					// Host ticks at which CYCCNT was 0
+static uint32_t dwtSeen;					// CYCCNT value exposed at the last sync
+
+static void (*gpioListener)(GPIO_TypeDef *port, uint32_t oldOdr, uint32_t newOdr);
+static void (*uartListener)(const uint8_t *data, uint32_t len);
+
+static GPIO_TypeDef *const ports[3] = { &simGPIOA, &simGPIOB, &simGPIOC };
+
+/* ---------------------------------------------------------------------------
+ * Register side effects
+ * ------------------------------------------------------------------------ */
+
+static void gpio_sync(int idx) {
+	GPIO_TypeDef *port = ports[idx];
+	uint32_t bsrr = port->BSRR;
+	if (bsrr) {
+		// Set has priority over reset when both bits are written
+		port->ODR = (port->ODR & ~(bsrr >> 16)) | (bsrr & 0xFFFFU);
+		port->BSRR = 0;
+		simStats.bsrrWrites++;
+	}
+	if (port->ODR != odrSeen[idx]) {
+		uint32_t old = odrSeen[idx];
+		odrSeen[idx] = port->ODR;
+		if (gpioListener) {
+			gpioListener(port, old, port->ODR);
+		}
+	}
+}
+
+static void exti_sync(void) {
+	if (!(simEXTI.PR & PR_SENTINEL)) {
+		extiPending &= ~simEXTI.PR;			// Written: clear every bit written as 1
+	}
+	simEXTI.PR = extiPending | PR_SENTINEL;
+}
+
+static uint64_t tim_ticks(const SimTimer *t) {
+	return (now - t->base) / ((uint64_t)t->psc + 1);
+}
+
+static void tim_sync(SimTimer *t) {
+	TIM_TypeDef *r = t->regs;
+	uint64_t period = (uint64_t)r->ARR + 1;
+
+	t->sr &= r->SR;							// rc_w0: bits written as 0 are cleared
+
+	// Counter written by software (or stopped): re-anchor the time base
+	bool anchor = (r->CNT != t->cnt) || !(r->CR1 & TIM_CR1_CEN);
+
+	if (r->EGR & TIM_EGR_UG) {
+		t->psc = r->PSC;
+		r->CNT = 0;
+		t->sr |= TIM_SR_UIF;
+		anchor = true;
+	}
+	t->sr |= r->EGR & 0x1EU;				// CC1G..CC4G
+	r->EGR = 0;
+
+	if (anchor) {
+		t->base = now - (SimTime)r->CNT * ((uint64_t)t->psc + 1);
+	}
+
+	t->cnt = (uint32_t)(tim_ticks(t) % period);
+	r->CNT = t->cnt;
+	r->SR = t->sr;
+}
+
+static void dma_sync(void) {
+	simDMA1.HISR &= ~simDMA1.HIFCR;
+	simDMA1.LISR &= ~simDMA1.LIFCR;
+	simDMA1.HIFCR = 0;
+	simDMA1.LIFCR = 0;
+
+	bool enabled = simDMA1_Stream6.CR & DMA_SCR_EN;
+	if (enabled && !dmaActive) {
+		dmaActive = true;
+		bool txReady = (simUSART2.CR1 & USART_CR1_UE) && (simUSART2.CR3 & USART_CR3_DMAT);
+		dmaDone = txReady ? now + (SimTime)simDMA1_Stream6.NDTR * simUSART2.BRR * 10 : SIM_NEVER;
+	} else if (!enabled && dmaActive) {
+		dmaActive = false;					// Disabled by software - abort
+		dmaDone = SIM_NEVER;
+	}
+}
+
+/**
+ * @brief Apply FLASH register writes and stores to the config sectors.
+ *
+ * Kept out of sim_sync() like sim_dwt_sync(): comparing the sector images
+ * costs a 256 KB scan, paid only on FLASH register accesses.
+*/
+void sim_flash_sync(void) {
+	uint32_t key = simFLASH.KEYR;
+	if (key) {
+		if (flashKey1 && key == FLASH_KEY2) {
+			flashLocked = false;
+			simFLASH.CR &= ~FLASH_CR_LOCK;
+		}
+		flashKey1 = (key == FLASH_KEY1);
+		simFLASH.KEYR = 0;
+	}
+	if (!(simFLASH.SR & FLASH_SR_SENTINEL)) {
+		flashSr &= ~(simFLASH.SR & FLASH_SR_W1C);	// Written: clear every flag written as 1
+	}
+	if (simFLASH.CR & FLASH_CR_LOCK) {
+		flashLocked = true;
+	}
+	if (flashLocked) {
+		simFLASH.CR = FLASH_CR_LOCK;				// CR ignores writes until unlocked
+	}
+
+	bool busy = now < flashBusyUntil;
+	if ((simFLASH.CR & FLASH_CR_STRT) && !busy) {
+		simFLASH.CR &= ~FLASH_CR_STRT;
+		uint32_t sector = FLASH_CR_SNB(simFLASH.CR) - SIM_CONFIG_SECTOR;
+		if ((simFLASH.CR & FLASH_CR_SER) && sector < SIM_CONFIG_SECTORS) {
+			uint32_t *cells = &flashCells[sector * SIM_SECTOR_WORDS];
+			memset(cells, 0xFF, SIM_SECTOR_WORDS * sizeof(uint32_t));
+			memcpy(&_sconfig[sector * SIM_SECTOR_WORDS], cells, SIM_SECTOR_WORDS * sizeof(uint32_t));
+			flashBusyUntil = now + SIM_MS(SIM_FLASH_ERASE_MS);
+		}
+	}
+
+	// Stores to the sector program it while PG is set - bits can only be cleared
+	if (memcmp(_sconfig, flashCells, sizeof(flashCells)) != 0) {
+		bool pg = simFLASH.CR & FLASH_CR_PG;
+		for (uint32_t i = 0; i < SIM_CONFIG_WORDS; i++) {
+			if (pg) {
+				flashCells[i] &= _sconfig[i];
+			}
+			_sconfig[i] = flashCells[i];
+		}
+		if (!pg) {
+			flashSr |= FLASH_SR_PGSERR;
+		}
+	}
+
+	simFLASH.SR = flashSr | (now < flashBusyUntil ? FLASH_SR_BSY : 0) | FLASH_SR_SENTINEL;
+}
+
+/**
+ * @brief Apply pending register side effects and refresh counters.
+ *
+ * Called by every peripheral macro before the access, and by the harness
+ * after every handler, so each register write is observed in order.
+*/
+void sim_sync(void) {
+	for (int i = 0; i < 3; i++) {
+		gpio_sync(i);
+	}
+	exti_sync();
+	tim_sync(&tim2);
+	dma_sync();
+	simUSART2.SR |= USART_SR_IDLE_TX;
+}
+
+/** @brief Host cycle counter backing DWT->CYCCNT */
+static uint64_t host_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Refresh DWT->CYCCNT from the host clock.
+ *
+ * Kept out of sim_sync() so the counter costs one clock read per access
+ * and nothing for the other peripherals.
+*/
+void sim_dwt_sync(void) {
+	uint64_t now = host_ticks();
+	bool running = (simCoreDebug.DEMCR & DEMCR_TRCENA) && (simDWT.CTRL & DWT_CTRL_CYCCNTENA);
+
+	if (simDWT.CYCCNT != dwtSeen || !running) {
+		dwtBase = now - simDWT.CYCCNT;		// Written by software or stopped - re-anchor
+	}
+	if (running) {
+		simDWT.CYCCNT = (uint32_t)(now - dwtBase);
+	}
+	dwtSeen = simDWT.CYCCNT;
+}
+
+/* ---------------------------------------------------------------------------
+ * Time-driven events
+ * ------------------------------------------------------------------------ */
+
+/** @brief Earliest time at which an enabled compare/update event occurs */
+static SimTime tim_next_event(const SimTimer *t) {
+	TIM_TypeDef *r = t->regs;
+	if (!(r->CR1 & TIM_CR1_CEN)) {
+		return SIM_NEVER;
+	}
+
+	uint64_t period = (uint64_t)r->ARR + 1;
+	uint64_t tickLen = (uint64_t)t->psc + 1;
+	uint64_t ticks = tim_ticks(t);
+	uint64_t pos = ticks % period;
+	SimTime next = SIM_NEVER;
+
+	if (r->DIER & TIM_SR_UIF) {
+		next = t->base + (ticks + period - pos) * tickLen;
+	}
+	const volatile uint32_t *ccr = &r->CCR1;
+	for (int ch = 0; ch < 4; ch++) {
+		if (r->DIER & (2U << ch)) {
+			uint64_t delta = ((uint64_t)ccr[ch] + period - pos) % period;
+			SimTime at = t->base + (ticks + (delta ? delta : period)) * tickLen;
+			if (at < next) {
+				next = at;
+			}
+		}
+	}
+	return next;
+}
+
+/** @brief Set the flags of every event due at the current time */
+static void tim_fire(SimTimer *t) {
+	TIM_TypeDef *r = t->regs;
+	uint32_t cnt = (uint32_t)(tim_ticks(t) % ((uint64_t)r->ARR + 1));
+	if (cnt == 0) {
+		t->sr |= TIM_SR_UIF;
+	}
+	const volatile uint32_t *ccr = &r->CCR1;
+	for (int ch = 0; ch < 4; ch++) {
+		if (ccr[ch] == cnt) {
+			t->sr |= 2U << ch;
+		}
+	}
+	r->SR = t->sr;
+}
+
+static void dma_complete(void) {
+	uint32_t len = simDMA1_Stream6.NDTR;
+	const uint8_t *src = (const uint8_t *)simDMA1_Stream6.M0AR;
+
+	simStats.uartBytes += len;
+	if (uartListener) {
+		uartListener(src, len);
+	}
+
+	simDMA1_Stream6.NDTR = 0;
+	simDMA1_Stream6.CR &= ~DMA_SCR_EN;
+	simDMA1.HISR |= DMA_HISR_TCIF6;
+	dmaActive = false;
+	dmaDone = SIM_NEVER;
+}
+
+/* ---------------------------------------------------------------------------
+ * NVIC and interrupt dispatch
+ * ------------------------------------------------------------------------ */
+
+static bool irq_line(IRQn_Type irq) {
+	switch (irq) {
+		case EXTI15_10_IRQn:	return extiPending & simEXTI.IMR & EXTI_LINES_15_10;
+		case TIM2_IRQn:			return tim2.sr & simTIM2.DIER & TIM_IRQ_FLAGS;
+		case DMA1_Stream6_IRQn:	return (simDMA1.HISR & DMA_HISR_IRQ6) && (simDMA1_Stream6.CR & DMA_SCR_IRQ_EN);
+		case USART2_IRQn:		return simUSART2.SR & simUSART2.CR1 & USART_IRQ_FLAGS;
+		default:				return false;
+	}
+}
+
+static void (*irq_handler(IRQn_Type irq))(void) {
+	switch (irq) {
+		case EXTI15_10_IRQn:	return EXTI15_10_IRQHandler;
+		case TIM2_IRQn:			return TIM2_IRQHandler;
+		case DMA1_Stream6_IRQn:	return DMA1_Stream6_IRQHandler;
+		case USART2_IRQn:		return USART2_IRQHandler;
+		default:				return NULL;
+	}
+}
+
+/** @brief Find the lowest-numbered enabled IRQ with an active request line */
+static int irq_pending(void) {
+	static const IRQn_Type irqs[] = { DMA1_Stream6_IRQn, TIM2_IRQn, USART2_IRQn, EXTI15_10_IRQn };
+	for (unsigned i = 0; i < sizeof(irqs) / sizeof(irqs[0]); i++) {
+		if (nvicEnabled[irqs[i]] && irq_handler(irqs[i]) && irq_line(irqs[i])) {
+			return irqs[i];
+		}
+	}
+	return -1;
+}
+
+/** @brief Run handlers while interrupts are unmasked and requests are active */
+static void irq_dispatch(void) {
+	if (inHandler) {
+		return;								// Single priority level - no nesting
+	}
+
+	for (int calls = 0; !primask; calls++) {
+		sim_sync();
+		int irq = irq_pending();
+		if (irq < 0) {
+			return;
+		}
+		if (calls >= MAX_NESTED_IRQS) {
+			fprintf(stderr, "sim: IRQ %d never clears its request\n", irq);
+			abort();
+		}
+
+		inHandler = true;
+		simStats.irqCount[irq]++;
+		irq_handler((IRQn_Type)irq)();
+		if (irq == USART2_IRQn) {
+			simUSART2.SR &= ~(USART_SR_RXNE | USART_SR_ORE);	// DR read by the handler
+		}
+		inHandler = false;
+	}
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn) {
+	nvicEnabled[IRQn] = true;
+	irq_dispatch();
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn) {
+	nvicEnabled[IRQn] = false;
+}
+
+void __disable_irq(void) {
+	primask = 1;
+}
+
+void __enable_irq(void) {
+	primask = 0;
+	irq_dispatch();
+}
+
+uint32_t __get_PRIMASK(void) {
+	return primask;
+}
+
+void __set_PRIMASK(uint32_t priMask) {
+	primask = priMask & 1U;
+	irq_dispatch();
+}
+
+/**
+ * @brief Sleep until an interrupt request is active.
+ *
+ * Advances virtual time to the next timer, DMA or input event. Like the
+ * real instruction it also wakes with PRIMASK set; the handler then runs
+ * once interrupts are re-enabled.
+*/
+void __WFI(void) {
+	simStats.wfiCount++;
+
+	for (;;) {
+		sim_sync();
+		if (irq_pending() >= 0) {
+			break;
+		}
+
+		SimTime timNext = tim_next_event(&tim2);
+		SimTime next = timNext;
+		if (dmaDone < next) next = dmaDone;
+		SimTime in = input ? input->next() : SIM_NEVER;
+		if (in < next) next = in;
+
+		if (next >= endTime || next == SIM_NEVER) {
+			now = endTime;
+			longjmp(endJump, 1);
+		}
+
+		now = next;
+		sim_sync();
+		if (timNext == now) {
+			tim_fire(&tim2);
+		}
+		if (dmaDone <= now) {
+			dma_complete();
+		}
+		if (input && input->next() <= now) {
+			input->fire(now);
+		}
+	}
+
+	irq_dispatch();
+}
+
+/* ---------------------------------------------------------------------------
+ * Harness API
+ * ------------------------------------------------------------------------ */
+
+/** @brief Current virtual time in core clock cycles */
+SimTime sim_now(void) {
+	return now;
+}
+
+/** @brief Register the source of external input events */
+void sim_set_input(const SimInput *in) {
+	input = in;
+}
+
+/** @brief Stop the simulation once virtual time reaches `end` */
+void sim_set_end(SimTime end) {
+	endTime = end;
+}
+
+/**
+ * @brief Run the firmware entry point until the end time is reached.
+ *
+ * The firmware main loop never returns; the harness regains control from
+ * __WFI() once virtual time reaches the end set with sim_set_end().
+*/
+void sim_run(int (*app)(void)) {
+	for (int i = 0; i < 3; i++) {
+		ports[i]->IDR = 0xFFFFU;			// Inputs idle high (pull-ups)
+	}
+	simEXTI.PR = PR_SENTINEL;
+	simUSART2.SR = USART_SR_IDLE_TX;
+	simFLASH.CR = FLASH_CR_LOCK;
+	simFLASH.SR = FLASH_SR_SENTINEL;
+	memset(flashCells, 0xFF, sizeof(flashCells));
+	memcpy(_sconfig, flashCells, sizeof(flashCells));
+
+	if (setjmp(endJump) == 0) {
+		app();
+	}
+	primask = 0;
+	inHandler = false;
+}
+
+/**
+ * @brief Drive an input pin and generate the EXTI edge it causes.
+ *
+ * @param port  GPIO port (&simGPIOC for the detectors)
+ * @param pin   Pin number
+ * @param level New pin level (false = low)
+*/
+void sim_gpio_input(GPIO_TypeDef *port, uint32_t pin, bool level) {
+	uint32_t bit = 1U << pin;
+	bool old = port->IDR & bit;
+	if (old == level) {
+		return;
+	}
+
+	port->IDR = level ? (port->IDR | bit) : (port->IDR & ~bit);
+
+	// EXTI lines 10-15 are routed to port C by SYSCFG->EXTICR in this firmware
+	if (port == &simGPIOC) {
+		bool edge = level ? (simEXTI.RTSR & bit) : (simEXTI.FTSR & bit);
+		if (edge && (simEXTI.IMR & bit)) {
+			extiPending |= bit;
+		}
+	}
+}
+
+/**
+ * @brief Deliver a byte on the USART2 RX line.
+ *
+ * The caller paces bytes at the line rate (10 bit times, 10 * BRR core
+ * cycles each). The receive interrupt runs once PRIMASK is clear.
+ *
+ * @return false if the byte was lost: receiver off, or the previous byte
+ * 		   still unread (overrun)
+*/
+bool sim_uart_rx(uint8_t byte) {
+	if (!(simUSART2.CR1 & USART_CR1_UE) || !(simUSART2.CR1 & USART_CR1_RE)) {
+		return false;
+	}
+	if (simUSART2.SR & USART_SR_RXNE) {
+		simUSART2.SR |= USART_SR_ORE;
+		return false;
+	}
+	simUSART2.DR = byte;
+	simUSART2.SR |= USART_SR_RXNE;
+	irq_dispatch();
+	return true;
+}
+
+/** @brief Register a callback for output pin changes */
+void sim_on_gpio(void (*cb)(GPIO_TypeDef *port, uint32_t oldOdr, uint32_t newOdr)) {
+	gpioListener = cb;
+}
+
+/** @brief Register a sink for bytes transmitted on USART2 */
+void sim_on_uart(void (*cb)(const uint8_t *data, uint32_t len)) {
+	uartListener = cb;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file sim.h
+ * @brief Host simulation harness: virtual time and peripheral models.
+*/
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32f446xx.h"
+
+/** @brief Simulated core clock (HSI, no PLL) */
+#define SIM_CORE_CLK		16000000ULL
+
+/** @brief Virtual time in core clock cycles */
+typedef uint64_t SimTime;
+
+#define SIM_NEVER			UINT64_MAX
+#define SIM_MS(ms)			((SimTime)(ms) * (SIM_CORE_CLK / 1000U))
+#define SIM_TO_MS(t)		((t) / (SIM_CORE_CLK / 1000U))
+
+/**
+ * @brief Source of external input events (detector edges, UART bytes...).
+ *
+ * `next` returns the virtual time of the next event (SIM_NEVER if none);
+ * `fire` is called once virtual time reaches it and should drive the
+ * inputs through sim_gpio_input().
+*/
+typedef struct {
+	SimTime (*next)(void);
+	void (*fire)(SimTime now);
+} SimInput;
+
+/** @brief Counters collected while the simulation runs */
+typedef struct {
+	uint64_t irqCount[SIM_NUM_IRQn];	/**< Handler invocations per IRQ */
+	uint64_t wfiCount;					/**< Calls to __WFI() */
+	uint64_t bsrrWrites;				/**< GPIO BSRR stores */
+	uint64_t uartBytes;					/**< Bytes shifted out of USART2 TX */
+} SimStats;
+
+extern SimStats simStats;
+
+// Function Prototypes
+SimTime sim_now(void);
+void sim_set_input(const SimInput *input);
+void sim_set_end(SimTime end);
+void sim_run(int (*app)(void));
+void sim_gpio_input(GPIO_TypeDef *port, uint32_t pin, bool level);
+void sim_on_gpio(void (*cb)(GPIO_TypeDef *port, uint32_t oldOdr, uint32_t newOdr));
+void sim_on_uart(void (*cb)(const uint8_t *data, uint32_t len));
+bool sim_uart_rx(uint8_t byte);
+
+#endif /* SIM_H_ */
@@ -0,0 +1,518 @@
+/**
+ * @file sim_main.c
+ * @brief Entry point of the host simulation build (`make sim`).
+ *
+ * Runs the unmodified firmware against the peripheral models in sim.c.
+ * Vehicle arrivals are either generated (Poisson, per lane) or replayed
+ * from a timestamped trace; each arrival presses the lane's detector and
+ * joins the lane's queue in the metrics model. At the end the harness
+ * prints per-lane service/wait statistics, interrupt and wake-up counts
+ * and the simulation speed.
+ *
+ * Trace formats (sorted by time):
+ * 	- CSV: one `time_ms,lane` pair per line, lanes numbered from 1,
+ * 	  `#` starts a comment.
+ * 	- Binary (`.bin`): little-endian `uint32_t time_ms, uint32_t lane` records.
+ *
+ * With `-c` the harness opens a pseudo-terminal in place of the USART2
+ * line: its name is printed at start, bytes written to it are delivered
+ * to the RX model at the line rate and the firmware output is copied to
+ * it. Virtual time is then paced to wall time so the console can be used
+ * interactively (e.g. `picocom /dev/pts/N`) or driven by a script.
+ *
+ * Usage: Traffic_Control_sim [-f trace] [-d seconds] [-r vehicles/min/lane]
+ *                            [-s seed] [-H headway_ms] [-p presence_ms] [-o queue.csv]
+ *                            [-i sample_s] [-q] [-t] [-c]
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "metrics.h"
+#include "lights.h"
+#include "systick.h"
+#include "controller.h"
+#include "uart.h"
+#include "latency.h"
+#include "monitor.h"
+#include "config.h"
+#include "stats.h"
+#include "profile.h"
+
+#include <termios.h>				// Last - defines CR1..CR3, which are register names above
+
+#define HOLD_MS			300			// Default time a detector stays pressed per vehicle
+#define GAP_MS			40			// Detector gap between two closely following vehicles
+#define DRAIN_MS		600000		// Longest run after the trace ends while queues drain
+#define CONSOLE_POLL_MS	10			// Pseudo-terminal read interval while no input is pending
+
+int app_main(void);					// Firmware main() renamed by the Makefile
+int _write(int file, char *ptr, int len);
+
+#define DETECTOR_PIN(pin)			pin,
+#define HEAD_PINS(red, green)		{ red, green },
+
+static const uint8_t detectorPin[BUTTONS] = { PINMAP_DETECTORS(DETECTOR_PIN) };
+static const uint8_t headPins[NUM_LIGHTS][2] = { PINMAP_LIGHTS(HEAD_PINS) };	// RED, GREEN
+
+static FILE *out;					// Host stdout (stdout itself feeds USART2)
+static bool quiet = false;
+static bool trace = false;
+
+static double ratePerMs;			// Arrival rate per lane (generator)
+static uint64_t rng = 88172645463325252ULL;
+static SimTime nextPoisson[BUTTONS];
+
+static FILE *traceFile = NULL;
+static bool traceBinary = false;
+static SimTime traceTime = SIM_NEVER;	// Next trace arrival (SIM_NEVER when exhausted)
+static int traceLane;
+static uint64_t traceLine = 0;
+
+static SimTime holdTime = SIM_MS(HOLD_MS);
+static SimTime nextPress[BUTTONS];
+static SimTime nextRelease[BUTTONS];
+static uint32_t trafficLow = 0;		// Detectors held low by vehicles, bit n = lane n
+static uint32_t loopLow = 0;		// Detectors pulled low by the latency test outputs (wired-AND)
+static uint64_t vehicles = 0;
+static bool runToDrain = false;		// Stop once the trace is exhausted and the queues are empty
+static SimTime drainEnd = SIM_NEVER;
+
+static int ptyFd = -1;				// Master side of the console pseudo-terminal (-c)
+static uint8_t rxBuf[256];			// Bytes read from the pseudo-terminal, not yet on the RX line
+static uint32_t rxLen = 0;
+static uint32_t rxPos = 0;
+static SimTime consoleNext = SIM_NEVER;
+static struct timespec wallStart;
+
+/* ---------------------------------------------------------------------------
+ * Arrival sources
+ * ------------------------------------------------------------------------ */
+
+static double uniform(void) {
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return ((rng >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+static SimTime poisson_after(SimTime t) {
+	double gapMs = -log(uniform()) / ratePerMs;
+	return t + (SimTime)(gapMs * (double)SIM_MS(1));
+}
+
+/** @brief Read the next trace record into traceTime/traceLane */
+static void trace_advance(void) {
+	traceTime = SIM_NEVER;
+	if (traceBinary) {
+		uint32_t rec[2];
+		if (fread(rec, sizeof(rec), 1, traceFile) == 1) {
+			traceTime = SIM_MS(rec[0]);
+			traceLane = (int)rec[1] - 1;
+		}
+		return;
+	}
+
+	char line[128];
+	while (fgets(line, sizeof(line), traceFile)) {
+		traceLine++;
+		unsigned long long ms;
+		int laneNum;
+		char *p = line + strspn(line, " \t");
+		if (*p == '#' || *p == '\n' || *p == '\0') {
+			continue;
+		}
+		if (sscanf(p, "%llu,%d", &ms, &laneNum) != 2) {
+			if (traceLine == 1) {
+				continue;						// Header row
+			}
+			fprintf(stderr, "trace line %llu: expected time_ms,lane\n", (unsigned long long)traceLine);
+			exit(1);
+		}
+		traceTime = SIM_MS(ms);
+		traceLane = laneNum - 1;
+		return;
+	}
+}
+
+/** @brief Time and lane of the next arrival from the active source */
+static SimTime arrival_next(int *laneOut) {
+	if (traceFile) {
+		*laneOut = traceLane;
+		return traceTime;
+	}
+
+	SimTime next = SIM_NEVER;
+	for (int i = 0; i < BUTTONS; i++) {
+		if (nextPoisson[i] < next) {
+			next = nextPoisson[i];
+			*laneOut = i;
+		}
+	}
+	return next;
+}
+
+static void arrival_consume(int laneIdx, SimTime now) {
+	if (traceFile) {
+		trace_advance();
+	} else {
+		nextPoisson[laneIdx] = poisson_after(now);
+	}
+}
+
+/* ---------------------------------------------------------------------------
+ * Detector and queue input source
+ * ------------------------------------------------------------------------ */
+
+/** @brief Drive a detector input low while a vehicle or the loopback output holds it */
+static void detector_drive(int laneIdx, uint32_t *source, bool low) {
+	uint32_t bit = 1U << laneIdx;
+	*source = low ? (*source | bit) : (*source & ~bit);
+	sim_gpio_input(&simGPIOC, detectorPin[laneIdx], !((trafficLow | loopLow) & bit));
+}
+
+/* ---------------------------------------------------------------------------
+ * Console pseudo-terminal
+ * ------------------------------------------------------------------------ */
+
+/** @brief Open the pseudo-terminal; the slave side is kept open in raw mode */
+static void console_open(void) {
+	ptyFd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (ptyFd < 0 || grantpt(ptyFd) || unlockpt(ptyFd)) {
+		perror("posix_openpt");
+		exit(1);
+	}
+	const char *name = ptsname(ptyFd);
+
+	// Raw slave: no echo of firmware output back into the RX line, no CR/LF mapping
+	int slave = open(name, O_RDWR | O_NOCTTY);
+	struct termios tio;
+	if (slave < 0 || tcgetattr(slave, &tio)) {
+		perror(name);
+		exit(1);
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+	fcntl(ptyFd, F_SETFL, fcntl(ptyFd, F_GETFL) | O_NONBLOCK);
+
+	fprintf(stderr, "console on %s\n", name);
+	clock_gettime(CLOCK_MONOTONIC, &wallStart);
+	consoleNext = 0;
+}
+
+/** @brief Hold virtual time at wall time, then feed the next byte to the RX line */
+static void console_fire(SimTime now) {
+	struct timespec wall;
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	double ahead = SIM_TO_MS(now) / 1000.0 - ((wall.tv_sec - wallStart.tv_sec) + (wall.tv_nsec - wallStart.tv_nsec) / 1e9);
+	if (ahead > 0) {
+		struct timespec pause = { (time_t)ahead, (long)((ahead - (time_t)ahead) * 1e9) };
+		nanosleep(&pause, NULL);
+	}
+
+	if (rxPos == rxLen) {
+		ssize_t n = read(ptyFd, rxBuf, sizeof(rxBuf));
+		rxLen = n > 0 ? (uint32_t)n : 0;
+		rxPos = 0;
+	}
+	if (rxPos < rxLen) {
+		sim_uart_rx(rxBuf[rxPos++]);
+		consoleNext = now + (SimTime)simUSART2.BRR * 10;		// 10 bit times per byte
+	} else {
+		consoleNext = now + SIM_MS(CONSOLE_POLL_MS);
+	}
+}
+
+static SimTime traffic_next(void) {
+	int laneIdx = -1;
+	SimTime next = arrival_next(&laneIdx);
+	if (consoleNext < next) next = consoleNext;
+	for (int i = 0; i < BUTTONS; i++) {
+		if (nextPress[i] < next) next = nextPress[i];
+		if (nextRelease[i] < next) next = nextRelease[i];
+	}
+	SimTime dep = metrics_next_event();
+	return dep < next ? dep : next;
+}
+
+static void traffic_fire(SimTime now) {
+	if (consoleNext <= now) {
+		console_fire(now);
+	}
+	for (int i = 0; i < BUTTONS; i++) {
+		if (nextPress[i] <= now) {
+			detector_drive(i, &trafficLow, true);
+			nextPress[i] = SIM_NEVER;
+		}
+		if (nextRelease[i] <= now) {
+			detector_drive(i, &trafficLow, false);
+			nextRelease[i] = SIM_NEVER;
+		}
+	}
+
+	int laneIdx = -1;
+	while (arrival_next(&laneIdx) <= now) {
+		arrival_consume(laneIdx, now);
+		if (laneIdx < 0 || laneIdx >= BUTTONS) {
+			continue;
+		}
+
+		// A vehicle following closely clears an occupied detector for a short gap first
+		if (nextRelease[laneIdx] != SIM_NEVER || nextPress[laneIdx] != SIM_NEVER) {
+			detector_drive(laneIdx, &trafficLow, false);
+			nextPress[laneIdx] = now + SIM_MS(GAP_MS);
+			nextRelease[laneIdx] = nextPress[laneIdx] + holdTime;
+		} else {
+			detector_drive(laneIdx, &trafficLow, true);
+			nextRelease[laneIdx] = now + holdTime;
+		}
+
+		metrics_arrival(laneIdx, now);
+		vehicles++;
+	}
+
+	metrics_fire(now);
+
+	if (runToDrain && traceTime == SIM_NEVER) {
+		if (drainEnd == SIM_NEVER) {
+			drainEnd = now + SIM_MS(DRAIN_MS);
+			sim_set_end(drainEnd);
+		}
+		if (metrics_queued() == 0) {
+			sim_set_end(now);
+		}
+	}
+}
+
+static const SimInput traffic = { traffic_next, traffic_fire };
+
+/* ---------------------------------------------------------------------------
+ * Output listeners
+ * ------------------------------------------------------------------------ */
+
+static void uart_out(const uint8_t *data, uint32_t len) {
+	if (!quiet) {
+		fwrite(data, 1, len, out);
+	}
+	if (ptyFd >= 0 && write(ptyFd, data, len) < 0) {
+		// Nobody reading the console - the output is lost like on an open line
+	}
+}
+
+static const char *light_state(uint32_t odr, int i) {
+	bool red = !(odr & (1U << headPins[i][0]));		// Active low
+	bool green = !(odr & (1U << headPins[i][1]));
+	return (red && green) ? "YELLOW" : red ? "RED" : green ? "GREEN" : "OFF";
+}
+
+static void gpio_out(GPIO_TypeDef *port, uint32_t oldOdr, uint32_t newOdr) {
+#ifdef LATENCY_TEST
+	// Spare outputs wired to the first detectors (open drain - only low pulls the line)
+	if (port == &simGPIOC) {
+		for (int i = 0; i < LATENCY_LANES; i++) {
+			uint32_t bit = 1U << (LATENCY_LOOP_SHIFT + i);
+			if ((oldOdr ^ newOdr) & bit) {
+				detector_drive(i, &loopLow, !(newOdr & bit));
+			}
+		}
+	}
+#endif
+	if (port != &simGPIOB) {
+		return;
+	}
+	for (int i = 0; i < NUM_LIGHTS; i++) {
+		const char *before = light_state(oldOdr, i);
+		const char *after = light_state(newOdr, i);
+		if (before == after) {
+			continue;
+		}
+		metrics_green(i, !strcmp(after, "GREEN"), sim_now());
+		if (trace) {
+			fprintf(out, "[%10.3f] light %d %s -> %s\n",
+					SIM_TO_MS(sim_now()) / 1000.0, i + 1, before, after);
+		}
+	}
+}
+
+/** @brief stdio cookie that feeds printf() output into the firmware's _write() */
+static ssize_t stdout_to_uart(void *cookie, const char *buf, size_t len) {
+	(void)cookie;
+	return _write(1, (char *)buf, (int)len);
+}
+
+/* ---------------------------------------------------------------------------
+ * Main
+ * ------------------------------------------------------------------------ */
+
+static void usage(const char *prog) {
+	fprintf(stderr, "usage: %s [-f trace] [-d seconds] [-r vehicles/min/lane] [-s seed]\n"
+					"       [-H headway_ms] [-p presence_ms] [-o queue.csv] [-i sample_s] [-q] [-t] [-c]\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	double seconds = -1;
+	double perMinute = 2;
+	uint32_t headwayMs = 2000;
+	double sampleSec = 60;
+	const char *tracePath = NULL;
+	FILE *queueCsv = NULL;
+	bool console = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:d:r:s:H:p:o:i:qtc")) != -1) {
+		switch (opt) {
+			case 'f': tracePath = optarg;									break;
+			case 'd': seconds = atof(optarg);								break;
+			case 'r': perMinute = atof(optarg);								break;
+			case 's': rng = strtoull(optarg, NULL, 0) | 1;					break;
+			case 'H': headwayMs = (uint32_t)atoi(optarg);					break;
+			case 'p': holdTime = SIM_MS(atoi(optarg));						break;
+			case 'o': queueCsv = fopen(optarg, "w");						break;
+			case 'i': sampleSec = atof(optarg);								break;
+			case 'q': quiet = true;											break;
+			case 't': trace = true;											break;
+			case 'c': console = true;										break;
+			default:  usage(argv[0]);
+		}
+	}
+
+	if (tracePath) {
+		traceFile = fopen(tracePath, "rb");
+		if (!traceFile) {
+			perror(tracePath);
+			return 1;
+		}
+		size_t n = strlen(tracePath);
+		traceBinary = n > 4 && !strcmp(tracePath + n - 4, ".bin");
+		trace_advance();
+		if (seconds < 0) {
+			runToDrain = true;
+		}
+	} else {
+		ratePerMs = perMinute / 60000.0;
+		for (int i = 0; i < BUTTONS; i++) {
+			nextPoisson[i] = ratePerMs > 0 ? poisson_after(SIM_MS(1000)) : SIM_NEVER;
+		}
+		if (seconds < 0) {
+			seconds = 3600;
+		}
+	}
+	for (int i = 0; i < BUTTONS; i++) {
+		nextPress[i] = SIM_NEVER;
+		nextRelease[i] = SIM_NEVER;
+	}
+
+	out = fdopen(dup(STDOUT_FILENO), "w");
+	stdout = fopencookie(NULL, "w", (cookie_io_functions_t){ .write = stdout_to_uart });
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	metrics_init(BUTTONS, headwayMs, queueCsv, (uint32_t)(sampleSec * 1000));
+	sim_on_uart(uart_out);
+	sim_on_gpio(gpio_out);
+	sim_set_input(&traffic);
+	if (!runToDrain) {
+		sim_set_end(SIM_MS(seconds * 1000.0));
+	}
+	if (console) {
+		console_open();
+	}
+
+	struct timespec t0, t1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	sim_run(app_main);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	double wall = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	double simSec = SIM_TO_MS(sim_now()) / 1000.0;
+	double hours = simSec / 3600.0;
+
+	fprintf(out, "\n--- simulation summary ---\n");
+	fprintf(out, "simulated time      %.1f s (%.2f h)\n", simSec, hours);
+	fprintf(out, "wall time           %.3f s\n", wall);
+	fprintf(out, "speed               %.0f simulated s per wall s\n", wall > 0 ? simSec / wall : 0);
+	fprintf(out, "vehicles            %llu\n", (unsigned long long)vehicles);
+	fprintf(out, "timer wake-ups      %lu (%.0f/h)\n", (unsigned long)systick_get_wakeups(),
+			hours > 0 ? systick_get_wakeups() / hours : 0);
+	fprintf(out, "EXTI15_10 IRQs      %llu\n", (unsigned long long)simStats.irqCount[EXTI15_10_IRQn]);
+	fprintf(out, "TIM2 IRQs           %llu\n", (unsigned long long)simStats.irqCount[TIM2_IRQn]);
+	fprintf(out, "DMA1_Stream6 IRQs   %llu\n", (unsigned long long)simStats.irqCount[DMA1_Stream6_IRQn]);
+	fprintf(out, "WFI calls           %llu\n", (unsigned long long)simStats.wfiCount);
+	fprintf(out, "GPIOB BSRR writes   %llu\n", (unsigned long long)simStats.bsrrWrites);
+	fprintf(out, "UART bytes sent     %llu\n", (unsigned long long)simStats.uartBytes);
+	fprintf(out, "UART bytes dropped  %lu\n", (unsigned long)uart2_log_dropped());
+	if (console) {
+		fprintf(out, "USART2 RX IRQs      %llu (%lu bytes dropped)\n", (unsigned long long)simStats.irqCount[USART2_IRQn],
+				(unsigned long)uart2_rx_dropped());
+	}
+	fprintf(out, "green gap-outs      %lu\n", (unsigned long)controller_get_actuation_stats()->gapOut);
+	fprintf(out, "green max-outs      %lu\n", (unsigned long)controller_get_actuation_stats()->maxOut);
+	const MonitorStatus *mon = monitor_status();
+	if (mon->fault == MONITOR_OK) {
+		fprintf(out, "conflict monitor    ok\n");
+	} else {
+		fprintf(out, "conflict monitor    FAULT %s at light %lu, %.3f s\n", monitor_fault_name(mon->fault),
+				(unsigned long)mon->light + 1, mon->time / 1e6);
+	}
+	const ConfigStatus *cfg = config_status();
+	fprintf(out, "config store        %s, %lu probes, %lu saves, %lu erases\n", cfg->loaded ? "loaded" : "defaults",
+			(unsigned long)cfg->probes, (unsigned long)cfg->saves, (unsigned long)cfg->erases);
+	StatsTier day = stats_tier(STATS_NUM_TIERS - 1, (uint32_t)SIM_TO_MS(sim_now()));
+	unsigned long binned = 0;
+	for (uint32_t n = day.newest >= day.length ? day.newest - day.length + 1 : 0; n <= day.newest; n++) {
+		for (int i = 0; i < NUM_LIGHTS; i++) {
+			binned += day.bins[n % day.length].lane[i].volume;
+		}
+	}
+	fprintf(out, "stats history       %lu detections in the last %lu x %lu min bins\n", binned,
+			(unsigned long)day.length, (unsigned long)day.minutes);
+	fprintf(out, "detector occupancy ");
+	for (int i = 0; i < NUM_LIGHTS; i++) {
+		fprintf(out, " %d: %.1f%%", i + 1, Light[i].occupancyAvg * 100.0 / 256.0);
+	}
+	fprintf(out, "\n");
+#ifdef PROFILE
+	static const char *const region[PROF_REGIONS] = {
+		"EXTI15_10", "TIM2", "DMA1_Stream6", "process_events", "changePhase", "lights_commit", "config_init"
+	};
+	fprintf(out, "profile (host ticks)   calls        min       mean        max\n");
+	for (int r = 0; r < PROF_REGIONS; r++) {
+		const ProfileRegionStats *s = &profileStats.region[r];
+		fprintf(out, "  %-16s %10lu %10lu %10.0f %10lu\n", region[r], (unsigned long)s->calls,
+				s->calls ? (unsigned long)s->min : 0UL, s->calls ? (double)s->total / s->calls : 0.0,
+				(unsigned long)s->max);
+	}
+#endif
+	fprintf(out, "\n");
+	metrics_report(out, sim_now());
+	int status = 0;
+#ifdef LATENCY_TEST
+	static const char *const channel[LAT_CHANNELS] = { "edge -> EXTI", "edge -> light", "timer lateness" };
+	bool pass = latency_timeouts() == 0;
+	fprintf(out, "\nlatency (us)           n        p50        p99        max      limit\n");
+	for (int c = 0; c < LAT_CHANNELS; c++) {
+		uint32_t p99 = latency_percentile(c, 990);
+		bool ok = p99 <= latency_limit(c);
+		pass = pass && ok;
+		fprintf(out, "  %-14s %8lu %10lu %10lu %10lu %10lu  %s\n", channel[c],
+				(unsigned long)latency_stats(c)->count, (unsigned long)latency_percentile(c, 500),
+				(unsigned long)p99, (unsigned long)latency_stats(c)->max,
+				(unsigned long)latency_limit(c), ok ? "PASS" : "FAIL");
+	}
+	fprintf(out, "  unanswered edges %lu\nlatency test %s\n", (unsigned long)latency_timeouts(),
+			pass ? "PASS" : "FAIL");
+	status = pass ? 0 : 1;
+#endif
+	fflush(out);
+	if (queueCsv) {
+		fclose(queueCsv);
+	}
+	return status;
+}
@@ -0,0 +1,169 @@
+/**
+ * @file stm32f446xx.h
+ * @brief Host stand-in for the CMSIS device header (simulation build only).
+ *
+ * Provides the register layouts, peripheral instances and core intrinsics
+ * used by the firmware so the unmodified sources in `Src/` compile for the
+ * host. Every peripheral access goes through `sim_sync()` first, which
+ * applies the side effects of the previous register write (BSRR, write-1-
+ * to-clear flags, DMA enable, timer events) and refreshes free-running
+ * counters from virtual time. See sim.c for the peripheral models.
+ *
+ * @note Peripheral macros expand to comma expressions, so they cannot be
+ *       used in static initializers.
+*/
+
+#ifndef SIM_STM32F446XX_H_
+#define SIM_STM32F446XX_H_
+
+#include <stdint.h>
+
+#define __IO	volatile
+#define __I		volatile const
+#define __O		volatile
+
+/** @brief Interrupt numbers (subset of the STM32F446 vector table) */
+typedef enum {
+	FLASH_IRQn			= 4,
+	DMA1_Stream6_IRQn	= 17,
+	TIM2_IRQn			= 28,
+	TIM3_IRQn			= 29,
+	USART2_IRQn			= 38,
+	EXTI15_10_IRQn		= 40,
+	SIM_NUM_IRQn		= 64
+} IRQn_Type;
+
+typedef struct {
+	__IO uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR, PLLCFGR, CFGR, CIR, AHB1RSTR, AHB2RSTR, AHB3RSTR, RESERVED0;
+	__IO uint32_t APB1RSTR, APB2RSTR, RESERVED1[2];
+	__IO uint32_t AHB1ENR, AHB2ENR, AHB3ENR, RESERVED2, APB1ENR, APB2ENR;
+} RCC_TypeDef;
+
+typedef struct {
+	__IO uint32_t IMR, EMR, RTSR, FTSR, SWIER, PR;
+} EXTI_TypeDef;
+
+typedef struct {
+	__IO uint32_t MEMRMP, PMC, EXTICR[4];
+} SYSCFG_TypeDef;
+
+typedef struct {
+	__IO uint32_t SR, DR, BRR, CR1, CR2, CR3, GTPR;
+} USART_TypeDef;
+
+/** @brief DMA stream registers; address registers are pointer-sized on the host */
+typedef struct {
+	__IO uint32_t CR, NDTR;
+	__IO uintptr_t PAR, M0AR, M1AR;
+	__IO uint32_t FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+	__IO uint32_t LISR, HISR, LIFCR, HIFCR;
+} DMA_TypeDef;
+
+typedef struct {
+	__IO uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR;
+	__IO uint32_t CCR1, CCR2, CCR3, CCR4, BDTR, DCR, DMAR, OR;
+} TIM_TypeDef;
+
+typedef struct {
+	__IO uint32_t ACR, KEYR, OPTKEYR, SR, CR, OPTCR;
+} FLASH_TypeDef;
+
+typedef struct {
+	__IO uint32_t CTRL, LOAD, VAL, CALIB;
+} SysTick_Type;
+
+typedef struct {
+	__IO uint32_t CTRL, CYCCNT, CPICNT, EXCCNT, SLEEPCNT, LSUCNT, FOLDCNT, PCSR;
+} DWT_Type;
+
+typedef struct {
+	__IO uint32_t DHCSR, DCRSR, DCRDR, DEMCR;
+} CoreDebug_Type;
+
+// Peripheral register blocks (defined in sim.c)
+extern GPIO_TypeDef simGPIOA, simGPIOB, simGPIOC;
+extern RCC_TypeDef simRCC;
+extern EXTI_TypeDef simEXTI;
+extern SYSCFG_TypeDef simSYSCFG;
+extern USART_TypeDef simUSART2;
+extern DMA_TypeDef simDMA1;
+extern DMA_Stream_TypeDef simDMA1_Stream6;
+extern TIM_TypeDef simTIM2;
+extern FLASH_TypeDef simFLASH;
+extern SysTick_Type simSysTick;
+extern DWT_Type simDWT;
+extern CoreDebug_Type simCoreDebug;
+
+void sim_sync(void);
+void sim_dwt_sync(void);
+void sim_flash_sync(void);
+
+#define GPIOA			(sim_sync(), &simGPIOA)
+#define GPIOB			(sim_sync(), &simGPIOB)
+#define GPIOC			(sim_sync(), &simGPIOC)
+#define RCC				(sim_sync(), &simRCC)
+#define EXTI			(sim_sync(), &simEXTI)
+#define SYSCFG			(sim_sync(), &simSYSCFG)
+#define USART2			(sim_sync(), &simUSART2)
+#define DMA1			(sim_sync(), &simDMA1)
+#define DMA1_Stream6	(sim_sync(), &simDMA1_Stream6)
+#define TIM2			(sim_sync(), &simTIM2)
+#define FLASH			(sim_sync(), sim_flash_sync(), &simFLASH)	// Also checks stores to the config sector
+#define SysTick			(sim_sync(), &simSysTick)
+#define DWT				(sim_dwt_sync(), &simDWT)		// CYCCNT runs on the host clock
+#define CoreDebug		(&simCoreDebug)
+
+// Core intrinsics and NVIC access
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+void __WFI(void);
+
+// Preemption hook for tests: handlers normally only run at __WFI()/__enable_irq(),
+// but a handler set here runs once, as an interrupt would, at a later barrier or
+// exclusive store - the points where lock-free code can be interrupted mid-update
+extern void (*simPreempt)(void);
+extern uint32_t simPreemptSkip;				// Points to pass before simPreempt runs
+extern uint32_t simExclusive;				// Local exclusive monitor, set by LDREX
+
+static inline void sim_preempt_point(void) {
+	void (*handler)(void) = simPreempt;
+	if (handler) {
+		if (simPreemptSkip) {
+			simPreemptSkip--;
+			return;
+		}
+		simPreempt = 0;
+		handler();
+		simExclusive = 0;					// Exception entry and return clear the monitor
+	}
+}
+
+#define __DMB()		(sim_preempt_point(), __atomic_thread_fence(__ATOMIC_SEQ_CST))
+#define __DSB()		__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __ISB()		__atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+// Exclusive access - the store fails when an interrupt ran since the load
+static inline uint32_t __LDREXW(volatile uint32_t *addr) { simExclusive = 1; return *addr; }
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr) {
+	sim_preempt_point();
+	if (!simExclusive) {
+		return 1;
+	}
+	simExclusive = 0;
+	*addr = value;
+	return 0;
+}
+static inline void __CLREX(void) { simExclusive = 0; }
+
+#endif /* SIM_STM32F446XX_H_ */
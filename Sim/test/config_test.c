@@ -0,0 +1,159 @@
+/**
+ * @file config_test.c
+ * @brief Two-sector config store on the flash model (`make configtest`).
+ *
+ * Includes config.c so a "reboot" can reset its statics and run the boot
+ * load again over the same flash image. controller_idle() is a stub the
+ * test switches.
+ * 	- Saves fill the live sector, then continue in slot 0 of the other
+ * 	  one without any erase.
+ * 	- The full sector is erased only once the controller is idle, never
+ * 	  while it runs a phase.
+ * 	- Boot loads the newest record whichever sector holds it, also with
+ * 	  both sectors programmed (reset before the erase) and with a torn
+ * 	  first record in the fresh sector (reset during the switch). A save
+ * 	  with the live sector full and the other one stale waits for the
+ * 	  idle erase.
+ * 	- A set that would let greenMax exceed maxGreen is refused.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "../../Src/config.c"
+
+#define CHECK(cond)		do { if (!(cond)) { fprintf(stderr, "  %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static uint32_t failures = 0;
+static bool idle = true;
+static uint32_t value = PARAMS[PARAM_PASSAGE].min;		// Passage time of the newest save
+static uint32_t saves = 0;
+static uint32_t erases = 0;
+
+bool controller_idle(void) {
+	return idle;
+}
+
+// Run the main loop until no erase is running - a poll may start the next one
+static void settle(void) {
+	config_poll();
+	while (erasing) {
+		__disable_irq();
+		__WFI();
+		__enable_irq();
+		config_poll();
+	}
+}
+
+static void save(void) {
+	value = (value >= PARAMS[PARAM_PASSAGE].max) ? PARAMS[PARAM_PASSAGE].min : value + 1U;
+	CHECK(config_set(PARAM_PASSAGE, value));
+	config_save();
+	settle();
+	saves++;
+}
+
+// Reset the store's RAM state and load from flash as at power-up
+static void reboot(void) {
+	erases += status.erases;
+	memset(&status, 0, sizeof(status));
+	live = 0;
+	nextSlot = 0;
+	nextSequence = 0;
+	dirty = false;
+	stale = false;
+	erasing = false;
+	eraseHeld = false;
+	config_init();
+}
+
+static bool sector_blank(uint32_t sector) {
+	for (uint32_t i = 0; i < SECTOR_WORDS; i++) {
+		if (_sconfig[sector * SECTOR_WORDS + i] != ERASED) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Saves until the live sector has `left` free slots
+static void fill(uint32_t left) {
+	while (nextSlot < CONFIG_SLOTS - left) {
+		save();
+	}
+}
+
+static int app(void) {
+	uart2_init();
+	systick_init();
+
+	reboot();
+	CHECK(!status.loaded && !stale);
+
+	// The allocated GREEN must fit within the maximum GREEN
+	CHECK(!config_set(PARAM_MAX_GREEN, config.greenMax - 1U) && !config_set(PARAM_GREEN_MAX, config.maxGreen + 1U));
+	CHECK(config.maxGreen == MAX_GREEN_TIME && config.greenMax == GREEN_MAX_MS);
+
+	save();
+	reboot();
+	CHECK(status.loaded && status.sector == CONFIG_SECTOR && status.slot == 0 && config.passageTime == value);
+
+	// Switch: the live sector fills, the next save goes to the other one while a phase runs
+	idle = false;
+	fill(0);
+	save();
+	CHECK(status.sector == CONFIG_SECTOR + 1U && status.slot == 0);
+	CHECK(status.erases == 0 && !erasing && stale && !sector_blank(0));
+
+	// Reset before the erase - both sectors programmed, the newer one wins
+	reboot();
+	CHECK(status.loaded && status.sector == CONFIG_SECTOR + 1U && config.passageTime == value && stale);
+	settle();
+	CHECK(!erasing && !sector_blank(0));
+
+	// Controller rests - the full sector is erased
+	idle = true;
+	settle();
+	CHECK(status.erases == 1U && !stale && sector_blank(0));
+	reboot();
+	CHECK(status.sector == CONFIG_SECTOR + 1U && config.passageTime == value && !stale);
+
+	// Reset during the next switch: sector 7 full, only the magic word of sector 6 slot 0 programmed
+	idle = false;
+	fill(0);
+	uint32_t full = value;
+	flash_unlock();
+	FLASH->CR = (FLASH->CR & ~FLASH_CR_PSIZE) | FLASH_CR_PSIZE_X32 | FLASH_CR_PG;
+	flash_program(slot_words(0, 0), CONFIG_MAGIC);
+	FLASH->CR &= ~FLASH_CR_PG;
+	flash_lock();
+	reboot();
+	CHECK(status.sector == CONFIG_SECTOR + 1U && status.slot == CONFIG_SLOTS - 1U && config.passageTime == full);
+	CHECK(stale);
+
+	// The next save needs the torn sector - it waits for the controller to rest
+	save();
+	CHECK(dirty && !erasing && status.sector == CONFIG_SECTOR + 1U);
+	idle = true;
+	settle();
+	CHECK(!dirty && status.sector == CONFIG_SECTOR && status.slot == 0);
+	CHECK(status.erases == 2U && !stale && sector_blank(1));		// The torn sector, then sector 7 after the switch
+	reboot();
+	CHECK(status.sector == CONFIG_SECTOR && config.passageTime == value && !stale);
+	return 0;
+}
+
+int main(void) {
+	int out = dup(STDOUT_FILENO);				// Firmware LOG() output is not part of the report
+	freopen("/dev/null", "w", stdout);
+	sim_run(app);
+	fflush(stdout);
+	dup2(out, STDOUT_FILENO);
+
+	printf("store       %lu slots per sector, %lu saves, %lu erases\n", (unsigned long)CONFIG_SLOTS,
+		   (unsigned long)saves, (unsigned long)erases);
+	printf("config store test %s\n", failures ? "FAIL" : "PASS");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,293 @@
+/**
+ * @file controller_test.c
+ * @brief Controller state machine against its transition table (`make controllertest`).
+ *
+ * Includes controller.c to reach dispatch() and the static tables. The
+ * state timer is replaced by a spy, so an entry action shows up as the
+ * deadline it armed (or the timer stopped in REST).
+ *
+ * 	- Every (leaf state, signal) pair has a case. A case forks the
+ * 	  initialised controller, drives the child into the leaf through real
+ * 	  transitions, delivers the signal with dispatch() and checks the leaf
+ * 	  it ends in, the phase selected and the entry action that ran - none
+ * 	  for an internal transition (ST_STAY).
+ * 	- Timer expiries go through controller_process_events(): an expiry
+ * 	  carrying an older timerGeneration (the timer was re-armed after it
+ * 	  was queued) must be ignored, the current one must act. An expiry
+ * 	  that finds the event ring full must still act once it is drained.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "sim.h"
+#include "systick.h"
+
+static bool timerArmed = false;
+static uint32_t timerStarts = 0;		// Entry actions that armed the state timer
+static uint32_t timerStops = 0;			// Entry actions that stopped it
+static uint32_t timerDelay = 0;			// Delay of the last arm (ms)
+static uint32_t timerDue = 0;			// Expiry of the last arm (ms)
+static uint32_t now = 100000;			// Time of the next signal (ms)
+
+static void spy_timer_start(SoftTimer *timer, uint32_t delayMs) {
+	timerArmed = true;
+	timerStarts++;
+	timerDelay = delayMs;
+	timerDue = now + delayMs;
+}
+
+static void spy_timer_stop(SoftTimer *timer) {
+	timerArmed = false;
+	timerStops++;
+}
+
+#define systick_timer_start		spy_timer_start
+#define systick_timer_stop		spy_timer_stop
+#include "../../Src/controller.c"
+#undef systick_timer_start
+#undef systick_timer_stop
+
+#define PHASE_A			0U				// "1-3", GREEN at power-up
+#define PHASE_B			1U				// "2-4"
+#define LANE_A			0U				// Detector calling PHASE_A
+#define LANE_B			1U				// Detector calling PHASE_B
+#define TEST_PASSAGE_MS	5000U			// Longer than GREEN_EXTENSION_MS, so a late call carries MIN_GREEN into EXTENSION
+
+#define CHECK(cond)		do { if (!(cond)) { fprintf(stderr, "  %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static uint32_t failures = 0;
+
+/** @brief One (state, signal) pair and the outcome the table gives it */
+typedef struct {
+	State from;
+	Signal sig;
+	uint32_t arg;		// Lane for SIG_DETECT, phase for SIG_FORCE
+	State to;			// Leaf after the dispatch
+	uint32_t phase;		// Phase selected after the dispatch
+	bool entered;		// A transition ran an entry action
+} Case;
+
+static const Case CASES[] = {
+	// Idle: a call is served at once (no gap data - no batching window), a forced phase too
+	{ ST_REST,		SIG_DETECT,	LANE_B,		ST_YELLOW,		PHASE_B,	true },
+	{ ST_REST,		SIG_TIMER,	0,			ST_REST,		NUM_PHASES,	false },
+	{ ST_REST,		SIG_FORCE,	PHASE_A,	ST_MIN_GREEN,	PHASE_A,	true },		// Nothing to stop - through ALL_RED
+	{ ST_BATCH,		SIG_DETECT,	LANE_A,		ST_BATCH,		NUM_PHASES,	false },
+	{ ST_BATCH,		SIG_TIMER,	0,			ST_YELLOW,		PHASE_B,	true },
+	{ ST_BATCH,		SIG_FORCE,	PHASE_A,	ST_MIN_GREEN,	PHASE_A,	true },		// Ahead of the queued PHASE_B
+	// Change: calls are placed, a forced phase waits for the running one
+	{ ST_YELLOW,	SIG_DETECT,	LANE_A,		ST_YELLOW,		PHASE_B,	false },
+	{ ST_YELLOW,	SIG_TIMER,	0,			ST_ALL_RED,		PHASE_B,	true },
+	{ ST_YELLOW,	SIG_FORCE,	PHASE_A,	ST_YELLOW,		PHASE_B,	false },
+	{ ST_ALL_RED,	SIG_DETECT,	LANE_A,		ST_ALL_RED,		PHASE_B,	false },
+	{ ST_ALL_RED,	SIG_TIMER,	0,			ST_MIN_GREEN,	PHASE_B,	true },
+	{ ST_ALL_RED,	SIG_FORCE,	PHASE_B,	ST_ALL_RED,		PHASE_B,	false },
+	// Green: a call on the phase holds MIN_GREEN for the queue, then extends it
+	{ ST_MIN_GREEN,	SIG_DETECT,	LANE_B,		ST_MIN_GREEN,	PHASE_B,	true },		// Re-armed for the later end
+	{ ST_MIN_GREEN,	SIG_TIMER,	0,			ST_REST,		NUM_PHASES,	true },		// Gap-out, nothing waiting
+	{ ST_MIN_GREEN,	SIG_FORCE,	PHASE_A,	ST_MIN_GREEN,	PHASE_B,	false },
+	{ ST_EXTENSION,	SIG_DETECT,	LANE_B,		ST_EXTENSION,	PHASE_B,	false },
+	{ ST_EXTENSION,	SIG_TIMER,	0,			ST_REST,		NUM_PHASES,	true },
+	{ ST_EXTENSION,	SIG_FORCE,	PHASE_A,	ST_YELLOW,		PHASE_A,	true },		// Extension ends at once
+};
+
+#define NUM_CASES		(sizeof(CASES) / sizeof(CASES[0]))
+
+static const char *const SIGNAL_NAME[NUM_SIGNALS] = { "DETECT", "TIMER", "FORCE" };
+
+// Deliver a signal when it would arrive: a timer at its expiry, anything else just before it
+static void deliver(Signal sig, uint32_t arg) {
+	if (sig == SIG_TIMER) {
+		now = timerDue;
+	} else {
+		now = timerArmed ? timerDue - 1U : now + 1000U;
+	}
+	dispatch(sig, arg, now);
+}
+
+// Drive a fresh controller from REST into `target` through real transitions
+static void reach(State target) {
+	if (target == ST_BATCH) {
+		for (uint32_t i = 0; i < 20; i++) {			// Busy PHASE_B lane - the window opens
+			now += 1000U;
+			estimator_arrival(&Light[DETECTOR_LIGHT[LANE_B]], now);
+		}
+		deliver(SIG_DETECT, LANE_B);
+		return;
+	}
+	if (target == ST_REST) {
+		return;
+	}
+
+	deliver(SIG_DETECT, LANE_B);						// PHASE_A lights stop for PHASE_B
+	if (state != target && state == ST_YELLOW) {
+		deliver(SIG_TIMER, 0);
+	}
+	if (state != target && state == ST_ALL_RED) {
+		deliver(SIG_TIMER, 0);
+	}
+	if (state != target && state == ST_MIN_GREEN) {
+		deliver(SIG_DETECT, LANE_B);					// Late call - still within the passage time at the end
+		deliver(SIG_TIMER, 0);
+	}
+}
+
+// Deadline the entry action of `leaf` arms, from the phase timing
+static uint32_t entry_deadline(State leaf) {
+	switch (leaf) {
+	case ST_BATCH:		return timing.batchEnd;
+	case ST_YELLOW:		return timing.yellowEnd;
+	case ST_ALL_RED:	return timing.clearEnd;
+	case ST_MIN_GREEN:	return timing.greenInitialEnd;
+	case ST_EXTENSION: {
+		uint32_t until = timing.lastExtension + config.passageTime;
+		return ((int32_t)(until - timing.greenMaxEnd) > 0) ? timing.greenMaxEnd : until;
+	}
+	default:			return 0;
+	}
+}
+
+// Child of a case - exit status is the number of failed checks
+static void run_case(const Case *c) {
+	reach(c->from);
+	CHECK(state == c->from);
+	if (state != c->from) {
+		exit(1);
+	}
+
+	uint32_t starts = timerStarts;
+	uint32_t stops = timerStops;
+	deliver(c->sig, c->arg);
+
+	CHECK(state == c->to);
+	CHECK(phase == c->phase);
+	CHECK(ENTRY[state] != NULL);					// Only leaves are ever current
+	if (!c->entered) {
+		CHECK(timerStarts == starts && timerStops == stops);
+	} else if (c->to == ST_REST) {
+		CHECK(timerStops > stops && !timerArmed);
+	} else {
+		CHECK(timerStarts > starts && timerArmed);
+		CHECK(timerDelay == entry_deadline(c->to) - now);
+	}
+	exit(failures ? 1 : 0);
+}
+
+// Child - an expiry queued before a re-arm must not end the re-armed interval
+static void run_stale_timer(const Case *unused) {
+	reach(ST_MIN_GREEN);
+	uint32_t generation = timerGeneration;
+	uint32_t staleDue = timerDue;
+
+	deliver(SIG_DETECT, LANE_B);						// Queue joins the discharge - MIN_GREEN re-armed
+	CHECK(state == ST_MIN_GREEN && timerGeneration == generation + 1U);
+	CHECK((int32_t)(timerDue - staleDue) > 0);
+
+	event_push_value(EVENT_TIMER_EXPIRED, 0, (uint64_t)staleDue * 1000U, generation);
+	controller_process_events();
+	CHECK(state == ST_MIN_GREEN);
+
+	event_push_value(EVENT_TIMER_EXPIRED, 0, (uint64_t)timerDue * 1000U, timerGeneration);
+	controller_process_events();
+	CHECK(state != ST_MIN_GREEN);
+	exit(failures ? 1 : 0);
+}
+
+// Child - an expiry that finds the event ring full is kept aside, not lost
+static void run_missed_timer(const Case *unused) {
+	reach(ST_YELLOW);
+	uint32_t queued = 0;
+	while (event_push(EVENT_VEHICLE_RELEASED, LANE_A, (uint64_t)now * 1000U)) {
+		queued++;
+	}
+	CHECK(queued > 0);
+
+	now = timerDue;
+	stateTimerExpired();
+	controller_process_events();
+	CHECK(!event_pending());
+	CHECK(state == ST_ALL_RED);
+	exit(failures ? 1 : 0);
+}
+
+// Run `child` in a copy of the initialised controller, true if it passed
+static bool forked(void (*child)(const Case *), const Case *c) {
+	fflush(NULL);
+	pid_t pid = fork();
+	if (pid == 0) {
+		child(c);
+	}
+	int status;
+	return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static uint32_t casesPassed = 0;
+static bool staleIgnored = false;
+static bool missedServed = false;
+
+static int app(void) {
+	lights_init();
+	uart2_init();
+	systick_init();
+	config_init();
+	map_lights();
+	intersection_init();
+	monitor_init();
+	lights_set_initial_state();
+	config_set(PARAM_PASSAGE, TEST_PASSAGE_MS);
+
+	// Table shape: every leaf has an entry action and a superstate without one
+	for (uint32_t s = 0; s < ST_IDLE; s++) {
+		CHECK(ENTRY[s] != NULL);
+		CHECK(PARENT[s] >= ST_IDLE && ENTRY[PARENT[s]] == NULL);
+	}
+
+	for (uint32_t s = 0; s < ST_IDLE; s++) {
+		for (uint32_t g = 0; g < NUM_SIGNALS; g++) {
+			const Case *c = NULL;
+			for (uint32_t i = 0; i < NUM_CASES; i++) {
+				if (CASES[i].from == s && CASES[i].sig == g) {
+					c = &CASES[i];
+				}
+			}
+			if (c == NULL) {
+				fprintf(stderr, "  no case for %s %s\n", STATE_NAME[s], SIGNAL_NAME[g]);
+				failures++;
+			} else if (forked(run_case, c)) {
+				casesPassed++;
+			} else {
+				fprintf(stderr, "  %s %s: expected %s, phase %lu, %s\n", STATE_NAME[s], SIGNAL_NAME[g],
+						STATE_NAME[c->to], (unsigned long)c->phase, c->entered ? "entry action" : "no entry action");
+				failures++;
+			}
+		}
+	}
+
+	staleIgnored = forked(run_stale_timer, NULL);
+	if (!staleIgnored) {
+		failures++;
+	}
+	missedServed = forked(run_missed_timer, NULL);
+	if (!missedServed) {
+		failures++;
+	}
+	return 0;
+}
+
+int main(void) {
+	int out = dup(STDOUT_FILENO);				// Firmware LOG() output is not part of the report
+	freopen("/dev/null", "w", stdout);
+	sim_run(app);
+	fflush(stdout);
+	dup2(out, STDOUT_FILENO);
+
+	printf("transitions %lu of %lu (state, signal) pairs as tabled\n", (unsigned long)casesPassed,
+		   (unsigned long)(ST_IDLE * NUM_SIGNALS));
+	printf("stale timer %s\n", staleIgnored ? "ignored" : "NOT ignored");
+	printf("full queue  expiry %s\n", missedServed ? "served" : "LOST");
+	printf("controller test %s\n", failures ? "FAIL" : "PASS");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file log_test.c
+ * @brief Log ring overflow policies (`make logtest`).
+ *
+ * Built once per policy. With UART_LOG_OVERFLOW = LOG_OVERFLOW_DROP_OLDEST
+ * a producer queues numbered records of varying length at about twice the
+ * line rate for BURST_MS, then stops. The test checks that
+ * 	- the line keeps draining at the 115200 baud line rate during the burst
+ * 	  (a drop must not stall or restart the DMA),
+ * 	- every record arrives whole and in order, with no bytes of a dropped
+ * 	  record left behind,
+ * 	- the newest record is delivered - overflow discards the oldest.
+ *
+ * With LOG_OVERFLOW_REPORT (the default policy, built with AddressSanitizer)
+ * messages too large for the ring are dropped until the lost count has
+ * ten digits; the next message must be preceded by the exact loss note,
+ * assembled without overrunning its stack buffer.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+#include "uart.h"
+#include "systick.h"
+
+#define BURST_MS		5000		// Producer runs this long
+#define DRAIN_MS		2000		// Quiet time after the burst
+#define PERIOD_MS		2			// One record per period
+#define MIN_RATE		0.98		// Share of the line rate the burst must reach
+
+#if UART_LOG_OVERFLOW == LOG_OVERFLOW_DROP_OLDEST
+
+static SimTime nextRecord = 0;
+static uint32_t written = 0;			// Records queued by the producer (numbered from 0)
+
+static char line[128];					// Record being reassembled from the wire
+static uint32_t lineLen = 0;
+static uint64_t burstBytes = 0;			// Bytes on the wire before the burst ended
+static uint32_t received = 0;
+static int64_t lastSeq = -1;
+static uint32_t errors = 0;
+
+// 24 to 56 bytes: "seq NNNNNNN " padded with '.' and ended by CR LF
+static uint32_t record_len(uint32_t seq) {
+	return 24U + (seq % 5U) * 8U;
+}
+
+static SimTime producer_next(void) {
+	return nextRecord;
+}
+
+// Runs from __WFI() - queues from "interrupt context" like a handler would
+static void producer_fire(SimTime now) {
+	char rec[64];
+	uint32_t len = record_len(written);
+	int n = snprintf(rec, sizeof(rec), "seq %07u ", (unsigned)written);
+	memset(rec + n, '.', len - 2U - (uint32_t)n);
+	rec[len - 2U] = '\r';
+	rec[len - 1U] = '\n';
+	uart2_write_buf(rec, len);
+	written++;
+
+	nextRecord += SIM_MS(PERIOD_MS);
+	if (nextRecord >= SIM_MS(BURST_MS)) {
+		nextRecord = SIM_NEVER;
+	}
+}
+
+static const SimInput producer = { producer_next, producer_fire };
+
+static void check_record(void) {
+	unsigned seq;
+	if (sscanf(line, "seq %7u ", &seq) != 1 || lineLen != record_len(seq)) {
+		printf("  torn record at #%u: %.*s\n", received, (int)(lineLen > 40 ? 40 : lineLen), line);
+		errors++;
+		return;
+	}
+	for (uint32_t i = 12; i < lineLen - 2U; i++) {
+		if (line[i] != '.') {
+			printf("  corrupt record %u\n", seq);
+			errors++;
+			return;
+		}
+	}
+	if ((int64_t)seq <= lastSeq) {
+		printf("  record %u after %lld - out of order\n", seq, (long long)lastSeq);
+		errors++;
+	}
+	lastSeq = seq;
+	received++;
+}
+
+static void uart_out(const uint8_t *data, uint32_t len) {
+	if (sim_now() <= SIM_MS(BURST_MS)) {
+		burstBytes += len;
+	}
+	for (uint32_t i = 0; i < len; i++) {
+		if (lineLen < sizeof(line)) {
+			line[lineLen] = (char)data[i];
+		}
+		lineLen++;
+		if (data[i] == '\n') {
+			check_record();
+			lineLen = 0;
+		}
+	}
+}
+
+static int app(void) {
+	uart2_init();
+	systick_init();
+	while (1) {
+		__disable_irq();
+		__WFI();
+		__enable_irq();
+	}
+	return 0;
+}
+
+int main(void) {
+	sim_on_uart(uart_out);
+	sim_set_input(&producer);
+	sim_set_end(SIM_MS(BURST_MS + DRAIN_MS));
+	sim_run(app);
+
+	double lineRate = (double)SIM_CORE_CLK / (simUSART2.BRR * 10.0);		// Bytes/s, 10 bit times per byte
+	double rate = burstBytes * 1000.0 / BURST_MS;
+	bool pass = true;
+
+	printf("queued      %u records (%.0f bytes/s offered)\n", written,
+		   (double)(24 + 56) / 2 * written * 1000.0 / BURST_MS);
+	printf("delivered   %u records, %lu bytes dropped\n", received, (unsigned long)uart2_log_dropped());
+	printf("drain rate  %.0f bytes/s of %.0f line rate (%.1f%%)\n", rate, lineRate, 100.0 * rate / lineRate);
+
+	if (rate < MIN_RATE * lineRate) {
+		printf("  drain rate below %.0f%% of the line rate\n", MIN_RATE * 100);
+		pass = false;
+	}
+	if (lastSeq != (int64_t)written - 1) {
+		printf("  newest record %u not delivered (last %lld)\n", written - 1U, (long long)lastSeq);
+		pass = false;
+	}
+	if (uart2_log_dropped() == 0) {
+		printf("  burst did not overflow the ring\n");
+		pass = false;
+	}
+	if (errors || lineLen) {
+		pass = false;
+	}
+	printf("log drain test %s\n", pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}
+
+#elif UART_LOG_OVERFLOW == LOG_OVERFLOW_REPORT
+
+#define BIG_DROPS		1000U			// Lost count reaches 1048576000 - ten digits
+
+static char big[1U << 20];				// Never fits the ring - each write of it is dropped whole
+static char wire[128];					// Everything sent on the line
+static uint32_t wireLen = 0;
+
+static void uart_out(const uint8_t *data, uint32_t len) {
+	for (uint32_t i = 0; i < len && wireLen < sizeof(wire); i++) {
+		wire[wireLen++] = (char)data[i];
+	}
+}
+
+static int app(void) {
+	uart2_init();
+	systick_init();
+	for (uint32_t i = 0; i < BIG_DROPS; i++) {
+		uart2_write_buf(big, sizeof(big));		// The loss note is rebuilt at every digit count on the way
+	}
+	uart2_write_buf("after\r\n", 7);
+	while (1) {
+		__disable_irq();
+		__WFI();
+		__enable_irq();
+	}
+	return 0;
+}
+
+int main(void) {
+	sim_on_uart(uart_out);
+	sim_set_end(SIM_MS(DRAIN_MS));
+	sim_run(app);
+
+	char expected[64];
+	unsigned long lost = (unsigned long)BIG_DROPS * sizeof(big);
+	snprintf(expected, sizeof(expected), "\r\n[log] %lu bytes dropped\r\nafter\r\n", lost);
+	bool pass = (uart2_log_dropped() == lost && wireLen == strlen(expected) &&
+				 memcmp(wire, expected, wireLen) == 0);
+
+	printf("dropped     %lu bytes, %lu bytes sent after the burst\n", (unsigned long)uart2_log_dropped(),
+		   (unsigned long)wireLen);
+	printf("log report test %s\n", pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}
+
+#else
+#error "log_test expects UART_LOG_OVERFLOW=LOG_OVERFLOW_DROP_OLDEST or LOG_OVERFLOW_REPORT"
+#endif
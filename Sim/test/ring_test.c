@@ -0,0 +1,379 @@
+/**
+ * @file ring_test.c
+ * @brief Ring buffer tests and push/pop timing (`make ringtest`).
+ *
+ * 	- SPSC and MPSC rings run many laps across the 2^32 index wrap, in FIFO
+ * 	  order, with RING_FULL and the drop counter at capacity.
+ * 	- MPSC lap stamps: filled slots read `lap + 1`, released slots `lap +
+ * 	  size`; a claimed but unpublished slot hides the slots after it.
+ * 	- MPSC producers interleave through the simulator's preemption hook
+ * 	  (simPreempt): "interrupt" producers, nested two deep, push from
+ * 	  inside another producer's push, either at its claim (the STREX then
+ * 	  fails and retries) or between claim and publish.
+ * 	  Every element must arrive once, in per-producer order.
+ * 	- Timing of the event queue (MPSC ring) against the per-source SPSC
+ * 	  queues with timestamp merge it replaced, in host nanoseconds per
+ * 	  push + pop. Informational - relative cost only, not target cycles.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+#include "ring.h"
+#include "event.h"
+
+#define SMALL			8U				// Capacity of the wrap test rings
+#define WRAP_START		(UINT32_MAX - 5U * SMALL)	// Indices start just below 2^32
+#define LAPS			64U
+#define STRESS_PUSHES	200000U
+#define TIMING_OPS		(1U << 22)
+
+#define CHECK(cond)		do { if (!(cond)) { printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static uint32_t failures = 0;
+
+RING_SPSC_DEFINE(SmallSpsc, small_spsc, uint32_t, SMALL)
+RING_MPSC_DEFINE(SmallMpsc, small_mpsc, uint32_t, SMALL)
+
+// Element of the interleaving test: producer and its sequence number
+typedef struct {
+	uint32_t producer;
+	uint32_t seq;
+} Tagged;
+
+#define PRODUCERS		3U				// Main loop, interrupt, nested interrupt
+RING_MPSC_DEFINE(TaggedRing, tagged_ring, Tagged, 16)
+
+/* ---------------------------------------------------------------------------
+ * Old event queue (before ring.h): one SPSC queue per interrupt source,
+ * merged by timestamp on the consumer side
+ * ------------------------------------------------------------------------ */
+
+#define OLD_QUEUE_SIZE	16U
+#define OLD_MASK		(OLD_QUEUE_SIZE - 1U)
+
+typedef struct {
+	uint8_t type;
+	uint8_t id;
+	uint32_t timestamp;
+} OldEvent;
+
+typedef struct {
+	OldEvent buf[OLD_QUEUE_SIZE];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	volatile uint32_t dropped;
+} OldQueue;
+
+static OldQueue oldDetector, oldTimer;
+
+static bool old_push(OldQueue *q, uint8_t type, uint8_t id, uint32_t timestamp) {
+	uint32_t head = q->head;
+	if (head - q->tail >= OLD_QUEUE_SIZE) {
+		q->dropped++;
+		return false;
+	}
+	OldEvent *slot = &q->buf[head & OLD_MASK];
+	slot->type = type;
+	slot->id = id;
+	slot->timestamp = timestamp;
+	__DMB();
+	q->head = head + 1;
+	return true;
+}
+
+static bool old_pop(OldQueue *q, OldEvent *ev) {
+	uint32_t tail = q->tail;
+	if (tail == q->head) {
+		return false;
+	}
+	__DMB();
+	*ev = q->buf[tail & OLD_MASK];
+	__DMB();
+	q->tail = tail + 1;
+	return true;
+}
+
+static bool old_pop_next(OldEvent *ev) {
+	bool haveDetector = oldDetector.tail != oldDetector.head;
+	bool haveTimer = oldTimer.tail != oldTimer.head;
+	if (haveDetector && haveTimer) {
+		__DMB();
+		uint32_t tDetector = oldDetector.buf[oldDetector.tail & OLD_MASK].timestamp;
+		uint32_t tTimer = oldTimer.buf[oldTimer.tail & OLD_MASK].timestamp;
+		return ((int32_t)(tTimer - tDetector) <= 0) ? old_pop(&oldTimer, ev) : old_pop(&oldDetector, ev);
+	}
+	if (haveTimer) {
+		return old_pop(&oldTimer, ev);
+	}
+	return old_pop(&oldDetector, ev);
+}
+
+/* ---------------------------------------------------------------------------
+ * Wrap, full and empty
+ * ------------------------------------------------------------------------ */
+
+// Put an empty MPSC ring at index `start`: slots before it are free for the next lap
+static void small_mpsc_seek(SmallMpsc *r, uint32_t start) {
+	memset(r, 0, sizeof(*r));
+	for (uint32_t i = 0; i < SMALL; i++) {
+		uint32_t pos = start + ((i - start) & (SMALL - 1U));		// First index >= start using slot i
+		r->slot[i].stamp = pos & ~(SMALL - 1U);
+	}
+	r->head = start;
+	r->tail = start;
+}
+
+static void test_spsc_wrap(void) {
+	static SmallSpsc r;
+	uint32_t in = 0, out = 0, v;
+	r.head = r.tail = WRAP_START;
+
+	for (uint32_t lap = 0; lap < LAPS; lap++) {
+		uint32_t fill = 1U + lap % SMALL;
+		for (uint32_t i = 0; i < fill; i++) {
+			CHECK(small_spsc_push(&r, &in) == RING_OK);
+			in++;
+		}
+		CHECK(small_spsc_count(&r) == fill);
+		while (small_spsc_pop(&r, &v) == RING_OK) {
+			CHECK(v == out);
+			out++;
+		}
+	}
+	CHECK(in == out);
+	CHECK((int32_t)(r.head - WRAP_START) > 0 && r.head < WRAP_START);		// Crossed 2^32
+
+	// Full: the element after capacity is rejected and counted, the ring is unchanged
+	for (uint32_t i = 0; i < SMALL; i++) {
+		CHECK(small_spsc_push(&r, &i) == RING_OK);
+	}
+	CHECK(small_spsc_push(&r, &in) == RING_FULL);
+	CHECK(r.dropped == 1);
+	for (uint32_t i = 0; i < SMALL; i++) {
+		CHECK(small_spsc_pop(&r, &v) == RING_OK && v == i);
+	}
+	CHECK(small_spsc_pop(&r, &v) == RING_EMPTY);
+	CHECK(small_spsc_peek(&r) == NULL && small_spsc_empty(&r));
+}
+
+static void test_mpsc_wrap(void) {
+	static SmallMpsc r;
+	uint32_t in = 0, out = 0, v;
+	small_mpsc_seek(&r, WRAP_START);
+
+	for (uint32_t lap = 0; lap < LAPS; lap++) {
+		uint32_t fill = 1U + lap % SMALL;
+		for (uint32_t i = 0; i < fill; i++) {
+			CHECK(small_mpsc_push(&r, &in) == RING_OK);
+			in++;
+		}
+		while (small_mpsc_pop(&r, &v) == RING_OK) {
+			CHECK(v == out);
+			out++;
+		}
+	}
+	CHECK(in == out);
+	CHECK((int32_t)(r.head - WRAP_START) > 0 && r.head < WRAP_START);
+
+	// Full: every slot stamped filled (lap + 1), the next push is dropped
+	uint32_t base = r.head;
+	for (uint32_t i = 0; i < SMALL; i++) {
+		CHECK(small_mpsc_push(&r, &i) == RING_OK);
+	}
+	for (uint32_t i = 0; i < SMALL; i++) {
+		uint32_t pos = base + i;
+		CHECK(r.slot[pos & (SMALL - 1U)].stamp == (pos & ~(SMALL - 1U)) + 1U);
+	}
+	CHECK(small_mpsc_push(&r, &in) == RING_FULL);
+	CHECK(r.dropped == 1 && r.head == base + SMALL);
+
+	// Empty: every slot released for the next lap (lap + size)
+	for (uint32_t i = 0; i < SMALL; i++) {
+		CHECK(small_mpsc_pop(&r, &v) == RING_OK && v == i);
+	}
+	for (uint32_t i = 0; i < SMALL; i++) {
+		uint32_t pos = base + i;
+		CHECK(r.slot[pos & (SMALL - 1U)].stamp == (pos & ~(SMALL - 1U)) + SMALL);
+	}
+	CHECK(small_mpsc_pop(&r, &v) == RING_EMPTY);
+	CHECK(small_mpsc_peek(&r) == NULL && small_mpsc_empty(&r));
+
+	// A zeroed ring is empty and usable
+	static SmallMpsc zero;
+	CHECK(small_mpsc_empty(&zero));
+	CHECK(small_mpsc_push(&zero, &in) == RING_OK && small_mpsc_pop(&zero, &v) == RING_OK && v == in);
+}
+
+/* ---------------------------------------------------------------------------
+ * Producers interleaved by preemption
+ * ------------------------------------------------------------------------ */
+
+static TaggedRing tagged;
+static uint32_t pushed[PRODUCERS];		// Next sequence number per producer
+static uint32_t accepted[PRODUCERS];	// Elements the ring took per producer
+static uint32_t preemptions = 0;
+static uint32_t hiddenChecks = 0;		// Preemptions that landed between claim and publish
+static uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t next_random(uint32_t range) {
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return (uint32_t)(rng % range);
+}
+
+static void producer_push(uint32_t producer) {
+	Tagged t = { producer, pushed[producer] };
+	if (tagged_ring_push(&tagged, &t) == RING_OK) {
+		accepted[producer]++;
+	}
+	pushed[producer]++;
+}
+
+static void nested_interrupt(void) {
+	preemptions++;
+	producer_push(2);
+}
+
+// "Interrupt" producer: runs inside a main-loop push, may itself be preempted once
+static void interrupt(void) {
+	preemptions++;
+	uint32_t before = tagged.head;
+	bool claimedUnpublished = tagged.slot[(before - 1U) & 15U].stamp != ((before - 1U) & ~15U) + 1U
+							  && before != tagged.tail;
+
+	if (next_random(4) == 0) {
+		simPreemptSkip = next_random(2);
+		simPreempt = nested_interrupt;
+	}
+	for (uint32_t n = 1 + next_random(2); n > 0; n--) {
+		producer_push(1);
+	}
+	simPreempt = NULL;
+	simPreemptSkip = 0;
+
+	// Main loop claimed the slot before ours and has not published it: the consumer must see nothing past it
+	if (claimedUnpublished && before - tagged.tail == 1U) {
+		hiddenChecks++;
+		CHECK(tagged_ring_peek(&tagged) == NULL);
+	}
+}
+
+static void test_mpsc_preemption(void) {
+	uint32_t next[PRODUCERS] = { 0 };
+	uint32_t popped[PRODUCERS] = { 0 };
+	Tagged t;
+
+	for (uint32_t i = 0; i < STRESS_PUSHES; i++) {
+		if (next_random(3) == 0) {
+			simPreemptSkip = next_random(2);	// At the claim (STREX) or between claim and publish (DMB)
+			simPreempt = interrupt;
+		}
+		producer_push(0);
+		simPreempt = NULL;
+		simPreemptSkip = 0;
+
+		// Consumer drains at random so the ring is sometimes full
+		if (next_random(4) == 0) {
+			while (tagged_ring_pop(&tagged, &t) == RING_OK) {
+				CHECK(t.producer < PRODUCERS);
+				CHECK(t.seq >= next[t.producer]);		// Per-producer order (dropped ones skipped)
+				next[t.producer] = t.seq + 1U;
+				popped[t.producer]++;
+			}
+		}
+	}
+	while (tagged_ring_pop(&tagged, &t) == RING_OK) {
+		CHECK(t.seq >= next[t.producer]);
+		next[t.producer] = t.seq + 1U;
+		popped[t.producer]++;
+	}
+
+	uint32_t total = 0, lost = 0;
+	for (uint32_t p = 0; p < PRODUCERS; p++) {
+		CHECK(popped[p] == accepted[p]);			// Nothing lost or duplicated once accepted
+		total += pushed[p];
+		lost += pushed[p] - accepted[p];
+	}
+	CHECK(lost == tagged.dropped);
+	CHECK(preemptions > 0 && hiddenChecks > 0 && pushed[2] > 0);
+	printf("interleave  %u pushes (%u main, %u interrupt, %u nested), %u preemptions, %u dropped full, "
+		   "%u unpublished-slot checks\n", total, pushed[0], pushed[1], pushed[2], preemptions, lost, hiddenChecks);
+}
+
+/* ---------------------------------------------------------------------------
+ * Timing
+ * ------------------------------------------------------------------------ */
+
+static double elapsed_ns(const struct timespec *t0) {
+	struct timespec t1;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	return (t1.tv_sec - t0->tv_sec) * 1e9 + (t1.tv_nsec - t0->tv_nsec);
+}
+
+static void test_timing(void) {
+	volatile uint32_t sink = 0;
+	struct timespec t0;
+	Event ev;
+	OldEvent old;
+
+	// One element in flight: push then pop
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (uint32_t i = 0; i < TIMING_OPS; i++) {
+		event_push(EVENT_VEHICLE_DETECTED, (uint8_t)i, i);
+		event_pop(&ev);
+		sink += ev.id;
+	}
+	double ringSingle = elapsed_ns(&t0) / TIMING_OPS;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (uint32_t i = 0; i < TIMING_OPS; i++) {
+		old_push(&oldDetector, 0, (uint8_t)i, i);
+		old_pop_next(&old);
+		sink += old.id;
+	}
+	double oldSingle = elapsed_ns(&t0) / TIMING_OPS;
+
+	// Bursts from two sources: 8 detector and 8 timer events, then drain
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (uint32_t i = 0; i < TIMING_OPS; i += 16) {
+		for (uint32_t k = 0; k < 16; k++) {
+			event_push((k & 1) ? EVENT_TIMER_EXPIRED : EVENT_VEHICLE_DETECTED, (uint8_t)k, i + k);
+		}
+		while (event_pop(&ev)) {
+			sink += ev.id;
+		}
+	}
+	double ringBurst = elapsed_ns(&t0) / TIMING_OPS;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (uint32_t i = 0; i < TIMING_OPS; i += 16) {
+		for (uint32_t k = 0; k < 16; k++) {
+			old_push((k & 1) ? &oldTimer : &oldDetector, (uint8_t)(k & 1), (uint8_t)k, i + k);
+		}
+		while (old_pop_next(&old)) {
+			sink += old.id;
+		}
+	}
+	double oldBurst = elapsed_ns(&t0) / TIMING_OPS;
+
+	CHECK(event_dropped() == 0 && oldDetector.dropped == 0 && oldTimer.dropped == 0);
+	printf("timing      ns per push + pop     single   burst of 16\n");
+	printf("            MPSC event ring     %8.2f  %8.2f\n", ringSingle, ringBurst);
+	printf("            old SPSC + merge    %8.2f  %8.2f\n", oldSingle, oldBurst);
+	(void)sink;
+}
+
+int main(void) {
+	test_spsc_wrap();
+	test_mpsc_wrap();
+	printf("wrap        SPSC and MPSC, %u laps of %u slots across 2^32, full and empty\n", LAPS, SMALL);
+	test_mpsc_preemption();
+	test_timing();
+
+	printf("ring test %s\n", failures ? "FAIL" : "PASS");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,380 @@
+/**
+ * @file config.c
+ * @brief Flash parameter store: boot load, range checks and record writer.
+ *
+ * The writer runs from the main loop. Programming a record takes a few
+ * word writes of ~16 µs each; a sector erase takes 1-2 s and is started
+ * and then polled on a software timer. The F446 has a single flash bank,
+ * so instruction fetches stall while it programs or erases - this is why
+ * records are appended, a full sector is only erased once the other one
+ * holds the newest record, and an erase waits for the controller to rest.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32f446xx.h"
+
+#include "uart.h"
+#include "config.h"
+#include "profile.h"
+#include "systick.h"
+
+#define FLASH_KEY1				0x45670123U
+#define FLASH_KEY2				0xCDEF89ABU
+
+#define FLASH_SR_EOP			(1U<<0)
+#define FLASH_SR_OPERR			(1U<<1)
+#define FLASH_SR_WRPERR			(1U<<4)
+#define FLASH_SR_PGAERR			(1U<<5)
+#define FLASH_SR_PGPERR			(1U<<6)
+#define FLASH_SR_PGSERR			(1U<<7)
+#define FLASH_SR_BSY			(1U<<16)
+#define FLASH_SR_ERRORS			(FLASH_SR_OPERR | FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR)
+
+#define FLASH_CR_PG				(1U<<0)
+#define FLASH_CR_SER			(1U<<1)
+#define FLASH_CR_SNB_Pos		3
+#define FLASH_CR_SNB			(0xFU<<FLASH_CR_SNB_Pos)
+#define FLASH_CR_PSIZE			(3U<<8)
+#define FLASH_CR_PSIZE_X32		(2U<<8)
+#define FLASH_CR_STRT			(1U<<16)
+#define FLASH_CR_LOCK			(1U<<31)
+
+#define ERASED					0xFFFFFFFFU
+#define RECORD_WORDS			(sizeof(ConfigRecord) / sizeof(uint32_t))
+#define SECTOR_WORDS			(CONFIG_SECTOR_SIZE / sizeof(uint32_t))
+
+_Static_assert(sizeof(Config) == NUM_PARAMS * sizeof(uint32_t), "Config must be an array of uint32_t in CONFIG_PARAMS order");
+_Static_assert(sizeof(ConfigRecord) % sizeof(uint32_t) == 0, "Records are programmed a word at a time");
+_Static_assert(CONFIG_SECTORS == 2U, "The sectors take turns - the other one is live ^ 1");
+
+extern uint32_t _sconfig[];					// Start of the CONFIG region (linker scripts), CONFIG_SECTORS sectors
+
+#define CONFIG_INFO(id, field, def, min, max)		{ #field, (def), (min), (max) },
+
+static const struct {
+	const char *name;
+	uint32_t def;
+	uint32_t min;
+	uint32_t max;
+} PARAMS[NUM_PARAMS] = {
+	CONFIG_PARAMS(CONFIG_INFO)
+};
+
+Config config;
+static ConfigStatus status;
+
+static uint32_t live = 0;					// Sector (index in CONFIG) holding the newest record
+static uint32_t nextSlot = 0;				// First slot of `live` not yet programmed
+static uint32_t nextSequence = 0;
+static bool dirty = false;					// Save requested, not yet written
+static bool stale = false;					// The other sector holds old or torn records - erase it when idle
+static bool erasing = false;
+static bool eraseHeld = false;				// Last erase failed - retried after the next config_save()
+
+static void eraseTimerExpired(void);
+static SoftTimer eraseTimer = { .callback = eraseTimerExpired };
+
+// Wake-up only - config_poll() checks BSY from the main loop
+static void eraseTimerExpired(void) {
+}
+
+/* CRC-32 (IEEE 802.3, reflected), four bits per step */
+static const uint32_t CRC_NIBBLE[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32_t crc32(const uint32_t *words, uint32_t n) {
+	uint32_t crc = ERASED;
+	for (uint32_t i = 0; i < n; i++) {
+		crc ^= words[i];
+		for (int k = 0; k < 8; k++) {
+			crc = (crc >> 4) ^ CRC_NIBBLE[crc & 0xFU];
+		}
+	}
+	return ~crc;
+}
+
+static uint32_t *slot_words(uint32_t sector, uint32_t slot) {
+	return _sconfig + sector * SECTOR_WORDS + slot * RECORD_WORDS;
+}
+
+static bool params_valid(const Config *c) {
+	const uint32_t *v = (const uint32_t *)c;
+	for (uint32_t p = 0; p < NUM_PARAMS; p++) {
+		if (v[p] < PARAMS[p].min || v[p] > PARAMS[p].max) {
+			return false;
+		}
+	}
+	// The allocated GREEN is bounded by greenMax and must fit within maxGreen
+	return c->greenMin <= c->greenMax && c->greenMax <= c->maxGreen;
+}
+
+static bool slot_valid(uint32_t sector, uint32_t slot) {
+	const uint32_t *w = slot_words(sector, slot);
+	const ConfigRecord *rec = (const ConfigRecord *)w;
+	return rec->magic == CONFIG_MAGIC && rec->crc == crc32(w, RECORD_WORDS - 1) && params_valid(&rec->params);
+}
+
+static bool slot_blank(uint32_t sector, uint32_t slot) {
+	const uint32_t *w = slot_words(sector, slot);
+	for (uint32_t i = 0; i < RECORD_WORDS; i++) {
+		if (w[i] != ERASED) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/** @brief Set every parameter to its compile-time default (RAM only) */
+void config_defaults(void) {
+	uint32_t *v = (uint32_t *)&config;
+	for (uint32_t p = 0; p < NUM_PARAMS; p++) {
+		v[p] = PARAMS[p].def;
+	}
+}
+
+// Slots are used in order - binary search for the first unused one
+static uint32_t sector_used(uint32_t sector) {
+	uint32_t lo = 0;
+	uint32_t hi = CONFIG_SLOTS;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		status.probes++;
+		if (slot_words(sector, mid)[0] != ERASED) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/**
+ * @brief Load the newest valid record, or the defaults.
+ *
+ * Call once at boot, after systick_init() and before anything reads
+ * `config`. Reads at most log2(CONFIG_SLOTS) + 1 magic words per sector
+ * plus one CRC per torn record at the end of each log; the time taken is
+ * kept in ConfigStatus.loadUs. A sector left over from a switch cut short
+ * by a reset - old records, or a torn first record - is erased later.
+*/
+void config_init(void) {
+	PROFILE_BEGIN(PROF_CONFIG_LOAD);
+	uint64_t start = systickGetMicros();
+	uint32_t used[CONFIG_SECTORS];
+	config_defaults();
+
+	for (uint32_t sector = 0; sector < CONFIG_SECTORS; sector++) {
+		used[sector] = sector_used(sector);
+
+		// Newest record whose CRC holds - a torn write only ever affects the last ones
+		for (uint32_t slot = used[sector]; slot-- > 0; ) {
+			status.probes++;
+			if (slot_valid(sector, slot)) {
+				const ConfigRecord *rec = (const ConfigRecord *)slot_words(sector, slot);
+				if (!status.loaded || (int32_t)(rec->sequence - status.sequence) > 0) {
+					config = rec->params;
+					status.loaded = true;
+					status.sequence = rec->sequence;
+					status.sector = CONFIG_SECTOR + sector;
+					status.slot = slot;
+					live = sector;
+				}
+				break;
+			}
+		}
+	}
+	nextSlot = used[live];
+	nextSequence = status.loaded ? status.sequence + 1 : 0;
+	stale = (used[live ^ 1U] != 0);
+
+#ifdef LATENCY_TEST
+	config.batchWindowMax = 0;				// The test measures the detection path, not call batching
+#endif
+
+	status.loadUs = (uint32_t)(systickGetMicros() - start);
+	PROFILE_END(PROF_CONFIG_LOAD);
+
+	if (status.loaded) {
+		LOG("Config: sector %lu record %lu (save %lu) loaded in %lu us, %lu probes", status.sector, status.slot,
+			status.sequence, status.loadUs, status.probes);
+	} else {
+		LOG("Config: defaults, no valid record (%lu us, %lu probes)", status.loadUs, status.probes);
+	}
+}
+
+/**
+ * @brief Change a parameter in RAM - takes effect at its next use.
+ *
+ * @return false if the value is outside the parameter's range or makes
+ * 		   the set inconsistent; `config` is then unchanged
+*/
+bool config_set(ConfigParam param, uint32_t value) {
+	if (param >= NUM_PARAMS) {
+		return false;
+	}
+
+	Config next = config;
+	((uint32_t *)&next)[param] = value;
+	if (!params_valid(&next)) {
+		return false;
+	}
+	config = next;
+	return true;
+}
+
+uint32_t config_get(ConfigParam param) {
+	return ((const uint32_t *)&config)[param];
+}
+
+/** @brief Index of the parameter called `name`, or -1 */
+int32_t config_find(const char *name) {
+	for (uint32_t p = 0; p < NUM_PARAMS; p++) {
+		if (strcmp(name, PARAMS[p].name) == 0) {
+			return (int32_t)p;
+		}
+	}
+	return -1;
+}
+
+const char *config_name(ConfigParam param) {
+	return PARAMS[param].name;
+}
+
+/** @brief Write the current parameters to flash from the main loop (config_poll()) */
+void config_save(void) {
+	dirty = true;
+	eraseHeld = false;
+}
+
+/** @brief A save or erase is pending */
+bool config_busy(void) {
+	return dirty || erasing;
+}
+
+static void flash_unlock(void) {
+	if (FLASH->CR & FLASH_CR_LOCK) {
+		FLASH->KEYR = FLASH_KEY1;
+		FLASH->KEYR = FLASH_KEY2;
+	}
+	FLASH->SR = FLASH_SR_ERRORS | FLASH_SR_EOP;		// Clear flags of earlier operations
+}
+
+static void flash_lock(void) {
+	FLASH->CR |= FLASH_CR_LOCK;
+}
+
+// Program one word - the caller has set PG
+static bool flash_program(uint32_t *addr, uint32_t word) {
+	*(volatile uint32_t *)addr = word;
+	while (FLASH->SR & FLASH_SR_BSY) {
+	}
+	return !(FLASH->SR & FLASH_SR_ERRORS) && *(volatile uint32_t *)addr == word;
+}
+
+// Program the current parameters as a new record, magic first and CRC last
+static bool write_record(uint32_t sector, uint32_t slot) {
+	ConfigRecord rec = { .magic = CONFIG_MAGIC, .sequence = nextSequence, .params = config };
+	rec.crc = crc32((const uint32_t *)&rec, RECORD_WORDS - 1);
+	const uint32_t *src = (const uint32_t *)&rec;
+	uint32_t *dst = slot_words(sector, slot);
+	bool ok = true;
+
+	flash_unlock();
+	FLASH->CR = (FLASH->CR & ~FLASH_CR_PSIZE) | FLASH_CR_PSIZE_X32 | FLASH_CR_PG;
+	for (uint32_t i = 0; i < RECORD_WORDS && ok; i++) {
+		ok = flash_program(&dst[i], src[i]);
+	}
+	FLASH->CR &= ~FLASH_CR_PG;
+	flash_lock();
+
+	return ok && slot_valid(sector, slot);
+}
+
+static void start_erase(uint32_t sector) {
+	flash_unlock();
+	FLASH->CR = (FLASH->CR & ~(FLASH_CR_SNB | FLASH_CR_PSIZE)) | FLASH_CR_PSIZE_X32 | FLASH_CR_SER |
+				((CONFIG_SECTOR + sector) << FLASH_CR_SNB_Pos);
+	FLASH->CR |= FLASH_CR_STRT;
+	erasing = true;
+	systick_timer_start(&eraseTimer, CONFIG_ERASE_POLL_MS);
+	LOG("Config: erasing sector %lu", CONFIG_SECTOR + sector);
+}
+
+// Write a pending save to the live sector, or to slot 0 of the other one once the live one is full
+static void save_record(void) {
+	uint32_t sector = live;
+	uint32_t slot = nextSlot;
+	if (slot >= CONFIG_SLOTS || !slot_blank(sector, slot)) {
+		if (stale) {
+			return;							// The other sector is erased first, once the controller rests
+		}
+		sector = live ^ 1U;
+		slot = 0;
+	}
+
+	dirty = false;
+	if (write_record(sector, slot)) {
+		if (sector != live) {
+			live = sector;					// The newest record is safe - the full sector can go
+			stale = true;
+		}
+		nextSlot = slot + 1;
+		status.sequence = nextSequence++;
+		status.sector = CONFIG_SECTOR + sector;
+		status.slot = slot;
+		status.saves++;
+		LOG("Config: saved to sector %lu record %lu (save %lu)", status.sector, status.slot, status.sequence);
+	} else {
+		if (sector == live) {
+			nextSlot = slot + 1;			// Never program over a failed slot again
+		} else {
+			stale = true;					// Erase the other sector before trying it again
+		}
+		status.errors++;
+		LOG("Config: write to sector %lu record %lu failed", CONFIG_SECTOR + sector, slot);
+	}
+}
+
+/**
+ * @brief Advance a pending save or erase - called from the main loop.
+ *
+ * Writes the record as soon as there is a slot for it. The sector that is
+ * not live is erased once it is stale and the controller is idle; a save
+ * waits for that erase only when the live sector is full.
+*/
+void config_poll(void) {
+	if (erasing) {
+		if (FLASH->SR & FLASH_SR_BSY) {
+			systick_timer_start(&eraseTimer, CONFIG_ERASE_POLL_MS);
+			return;
+		}
+		bool failed = FLASH->SR & FLASH_SR_ERRORS;
+		FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+		flash_lock();
+		erasing = false;
+		status.erases++;
+		if (failed) {
+			eraseHeld = true;				// Still stale
+			status.errors++;
+			LOG("Config: sector %lu erase failed", CONFIG_SECTOR + (live ^ 1U));
+		} else {
+			stale = false;
+		}
+	}
+
+	if (dirty) {
+		save_record();
+	}
+	if (stale && !erasing && !eraseHeld && controller_idle()) {
+		start_erase(live ^ 1U);
+	}
+}
+
+const ConfigStatus *config_status(void) {
+	return &status;
+}
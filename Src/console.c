@@ -0,0 +1,274 @@
+/**
+ * @file console.c
+ * @brief Command console: line assembly, tokenizer and command table.
+ *
+ * console_poll() drains the receive ring into the line buffer and runs at
+ * most one complete line per call, so a burst of input never holds up the
+ * events waiting behind it. An overlong line is discarded up to its
+ * terminator and reported once. Replies go through LOG() like every other
+ * message, so they are queued for the DMA and never wait on the line.
+ * A reply quoting a word of the line is assembled as raw text instead: the
+ * word lives in the line buffer, and a deferred LOG() sends only the address
+ * of a `%s` argument, which the next line would overwrite.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "uart.h"
+#include "event.h"
+#include "stats.h"
+#include "config.h"
+#include "lights.h"
+#include "console.h"
+#include "monitor.h"
+#include "systick.h"
+#include "estimator.h"
+#include "controller.h"
+#include "intersection.h"
+
+#define KEY_BACKSPACE		0x08
+#define KEY_DELETE			0x7F
+
+typedef struct {
+	const char *name;
+	const char *usage;
+	uint32_t minArgs;				// Words after the command name
+	void (*run)(uint32_t argc, char **argv);
+} Command;
+
+static char line[CONSOLE_LINE_MAX + 1];
+static uint32_t lineLen = 0;
+static bool overflow = false;		// Line longer than CONSOLE_LINE_MAX, discarded up to its end
+
+// Decimal number without sign or suffix
+static bool parse_u32(const char *text, uint32_t *value) {
+	uint32_t v = 0;
+	if (*text == '\0') {
+		return false;
+	}
+	for (; *text; text++) {
+		uint32_t digit = (uint32_t)(*text - '0');
+		if (digit > 9 || v > (UINT32_MAX - digit) / 10) {
+			return false;
+		}
+		v = v * 10 + digit;
+	}
+	*value = v;
+	return true;
+}
+
+// Phase by table name ("1-3") or by number from 1, NUM_PHASES if none
+static uint32_t parse_phase(const char *text) {
+	for (uint32_t p = 0; p < NUM_PHASES; p++) {
+		if (strcmp(text, PHASES[p].name) == 0) {
+			return p;
+		}
+	}
+	uint32_t n;
+	if (parse_u32(text, &n) && n >= 1 && n <= NUM_PHASES) {
+		return n - 1;
+	}
+	return NUM_PHASES;
+}
+
+// Reply quoting a word of the command line, queued as raw text
+static void reply_word(const char *before, const char *word, const char *after) {
+	const char *parts[] = { before, word, after, "\n\r" };
+	char reply[CONSOLE_LINE_MAX + 48];
+	size_t len = 0;
+
+	for (uint32_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+		size_t n = strnlen(parts[i], sizeof(reply) - len);
+		memcpy(&reply[len], parts[i], n);
+		len += n;
+	}
+	uart2_write_buf(reply, (uint32_t)len);
+}
+
+static void cmd_help(uint32_t argc, char **argv);
+
+static void cmd_stats(uint32_t argc, char **argv) {
+	uint32_t phase = controller_phase();
+	const ActuationStats *act = controller_get_actuation_stats();
+	uint32_t now = systickGetMillis();
+
+	LOG("uptime %lu ms, state %s, phase %s", now, controller_state_name(),
+		phase < NUM_PHASES ? PHASES[phase].name : "-");
+	LOG("green gap-outs %lu, max-outs %lu", act->gapOut, act->maxOut);
+	for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+		LOG("light %lu: queue %d, occupancy %lu%%, gap %lu ms", i + 1, Light[i].carCount,
+			Light[i].occupancyAvg * 100U / 256U, estimator_gap_ms(&Light[i]));
+	}
+	LOG("dropped: events %lu, log bytes %lu, rx bytes %lu", event_dropped(), uart2_log_dropped(),
+		uart2_rx_dropped());
+	LOG("timer wake-ups %lu", systick_get_wakeups());
+
+	const MonitorStatus *mon = monitor_status();
+	if (mon->fault == MONITOR_OK) {
+		LOG("monitor ok");
+	} else {
+		LOG("monitor FAULT %s at light %lu", monitor_fault_name(mon->fault), mon->light + 1);
+	}
+
+	const ConfigStatus *cfg = config_status();
+	LOG("config %s, save %lu, %lu saves, %lu erases, %lu errors", cfg->loaded ? "loaded" : "defaults",
+		cfg->sequence, cfg->saves, cfg->erases, cfg->errors);
+}
+
+static void cmd_get(uint32_t argc, char **argv) {
+	if (argc == 0) {
+		for (uint32_t p = 0; p < NUM_PARAMS; p++) {
+			LOG("%s = %lu", config_name((ConfigParam)p), config_get((ConfigParam)p));
+		}
+		return;
+	}
+
+	int32_t param = config_find(argv[0]);
+	if (param < 0) {
+		reply_word("error: no parameter '", argv[0], "'");
+		return;
+	}
+	LOG("%s = %lu", config_name((ConfigParam)param), config_get((ConfigParam)param));
+}
+
+static void cmd_set(uint32_t argc, char **argv) {
+	int32_t param = config_find(argv[0]);
+	uint32_t value;
+	if (param < 0) {
+		reply_word("error: no parameter '", argv[0], "'");
+	} else if (!parse_u32(argv[1], &value)) {
+		reply_word("error: '", argv[1], "' is not a number");
+	} else if (!config_set((ConfigParam)param, value)) {
+		LOG("error: %s = %lu out of range", config_name((ConfigParam)param), value);
+	} else {
+		LOG("%s = %lu", config_name((ConfigParam)param), value);
+	}
+}
+
+static void cmd_save(uint32_t argc, char **argv) {
+	config_save();
+	LOG("saving parameters");
+}
+
+static void cmd_force(uint32_t argc, char **argv) {
+	if (strcmp(argv[0], "phase") != 0) {
+		LOG("usage: force phase <n|name>");
+		return;
+	}
+
+	uint32_t phase = parse_phase(argv[1]);
+	if (phase == NUM_PHASES) {
+		reply_word("error: no phase '", argv[1], "'");
+	} else if (!controller_force_phase(phase)) {
+		LOG("error: event queue full");
+	}
+}
+
+static void cmd_trace(uint32_t argc, char **argv) {
+	if (strcmp(argv[0], "on") == 0) {
+		controller_set_trace(true);
+	} else if (strcmp(argv[0], "off") == 0) {
+		controller_set_trace(false);
+	} else {
+		LOG("usage: trace on|off");
+	}
+}
+
+static void cmd_export(uint32_t argc, char **argv) {
+	if (!stats_export(systickGetMillis())) {
+		LOG("error: export already running");
+	}
+}
+
+static const Command COMMANDS[] = {
+	{ "help",	"help",						0, cmd_help },
+	{ "stats",	"stats",					0, cmd_stats },
+	{ "get",	"get [param]",				0, cmd_get },
+	{ "set",	"set <param> <value>",		2, cmd_set },
+	{ "save",	"save",						0, cmd_save },
+	{ "force",	"force phase <n|name>",		2, cmd_force },
+	{ "trace",	"trace on|off",				1, cmd_trace },
+	{ "export",	"export",					0, cmd_export },
+};
+
+#define NUM_COMMANDS	(sizeof(COMMANDS) / sizeof(COMMANDS[0]))
+
+static void cmd_help(uint32_t argc, char **argv) {
+	for (uint32_t c = 0; c < NUM_COMMANDS; c++) {
+		LOG("  %s", COMMANDS[c].usage);
+	}
+}
+
+// Split the line in place and run its command
+static void execute(char *text) {
+	char *argv[CONSOLE_MAX_ARGS];
+	uint32_t argc = 0;
+
+	for (char *p = text; *p; ) {
+		if (*p == ' ' || *p == '\t') {
+			*p++ = '\0';
+			continue;
+		}
+		if (argc == CONSOLE_MAX_ARGS) {
+			LOG("error: too many arguments");
+			return;
+		}
+		argv[argc++] = p;
+		while (*p && *p != ' ' && *p != '\t') {
+			p++;
+		}
+	}
+	if (argc == 0) {
+		return;
+	}
+
+	for (uint32_t c = 0; c < NUM_COMMANDS; c++) {
+		if (strcmp(argv[0], COMMANDS[c].name) == 0) {
+			if (argc - 1 < COMMANDS[c].minArgs) {
+				LOG("usage: %s", COMMANDS[c].usage);
+			} else {
+				COMMANDS[c].run(argc - 1, &argv[1]);
+			}
+			return;
+		}
+	}
+	reply_word("error: unknown command '", argv[0], "' - try help");
+}
+
+/**
+ * @brief Read received bytes and run the next complete command line.
+ *
+ * Called from the main loop. Returns after one command, leaving later
+ * input in the receive ring for the next pass.
+*/
+void console_poll(void) {
+	uint8_t c;
+
+	while (uart2_read(&c)) {
+		if (c == '\r' || c == '\n') {
+			bool discarded = overflow;
+			line[lineLen] = '\0';
+			lineLen = 0;
+			overflow = false;
+			if (discarded) {
+				LOG("error: line longer than %d bytes", CONSOLE_LINE_MAX);
+				return;
+			}
+			if (line[0] != '\0') {
+				execute(line);
+				return;
+			}
+		} else if (c == KEY_BACKSPACE || c == KEY_DELETE) {
+			if (lineLen > 0) {
+				lineLen--;
+			}
+		} else if (lineLen < CONSOLE_LINE_MAX) {
+			line[lineLen++] = (char)c;
+		} else {
+			overflow = true;
+		}
+	}
+}
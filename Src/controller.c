@@ -5,187 +5,518 @@
 #include "stm32f446xx.h"
 
 #include "uart.h"
-#include "queue.h"
+#include "config.h"
+#include "event.h"
+#include "policy.h"
+#include "stats.h"
+#include "profile.h"
 #include "lights.h"
+#include "monitor.h"
 #include "systick.h"
+#include "estimator.h"
 #include "controller.h"
+#include "intersection.h"
 
-// Buttons to simulation sensor for car detection
-const uint32_t BUTTON[BUTTONS] = {BUTTON1, BUTTON2, BUTTON3, BUTTON4};
-
-bool timerActive = false;           // Flag to track if commonTimer is running
-uint32_t timerStartTime = 0;        // Start time of active timer
-uint32_t yellowStartTime = 0;
-uint32_t allocatedTime = 0;         // Time allocated for green light
-uint32_t activeLightPair = -1;		// Track which light pair has the timer
-
-bool waitingForProcess = false;		// 
-bool waitForTimer = false;			// Indicate another light Pair is waiting for the timer
-uint32_t waitingLightPair = -1;  	// Store the next subsequent pairs waiting to run
-bool firstPress = false;
-uint32_t firstPressTime = 0;
-uint32_t firstPair = -1;			// Store the pair that was pressed first
-uint32_t secondPair = -1;			// Store the pair that was pressed second
-
-// Monitor the GREEN light duration for the active light pair and transition when time expires
-// Function periodically invoked by SysTick_Handler to determine if allocated time has elapsed
-void checkGreenLightTimeout() {
-	uint32_t currentTime = systickGetMillis();
-
-	// Check if time allocated elapse
-	if (timerActive && (currentTime - timerStartTime >= allocatedTime * 1000)) {
-		LOG("Allocated time finished - Timer released\r\n");
-		timerActive = false;
-		activeLightPair = -1;
-
-		// Check for waiting pairs in the queue
-		uint32_t processPair = queue_dequeue();
-		if (processPair != -1) {
-			LOG("Processing waiting light pair %ld-%ld", processPair+1, processPair+3);
-			changeLight(processPair, processPair+2);
+/*
+ * Phase state machine
+ *
+ * 	IDLE      REST -> BATCH             no phase selected, calls gathered
+ * 	CHANGE    YELLOW -> ALL_RED         conflicting lights stopped for `phase`
+ * 	GREEN     MIN_GREEN -> EXTENSION    `phase` served until gap-out or max-out
+ *
+ * Every event is a signal looked up in TRANSITIONS[state][signal]; a leaf
+ * without a handler defers to its superstate's row, so dispatch is at most
+ * two table reads. Handlers return the next leaf, whose entry action arms
+ * the one state timer from the deadlines in `timing`, so no interval ever
+ * blocks the main loop. A state entered with nothing to wait for passes
+ * straight on (ALL_RED when no light had to stop).
+ *
+ * A forced phase (console `force phase`) is served next whatever the
+ * policy: an idle intersection changes at once, a running GREEN ends
+ * after its minimum interval without extensions.
+*/
+typedef enum {
+	ST_REST,			// Lights hold the last phase, no call waiting
+	ST_BATCH,			// Calls gathered for the adaptive batching window
+	ST_YELLOW,			// Conflicting lights YELLOW for `phase`
+	ST_ALL_RED,			// Conflicting lights RED, clearance before the GREEN
+	ST_MIN_GREEN,		// Initial GREEN - the allocated queue discharges
+	ST_EXTENSION,		// GREEN extended by detections within PASSAGE_TIME
+	ST_IDLE,			// Superstate of REST, BATCH
+	ST_CHANGE,			// Superstate of YELLOW, ALL_RED
+	ST_GREEN,			// Superstate of MIN_GREEN, EXTENSION
+	NUM_STATES,
+	ST_STAY = NUM_STATES	// Handler result: internal transition, no entry action
+} State;
+
+typedef enum {
+	SIG_DETECT,			// Vehicle detected, arg = lane
+	SIG_TIMER,			// State timer expired
+	SIG_FORCE,			// Operator forced a phase, arg = phase
+	NUM_SIGNALS
+} Signal;
+
+static const char *const STATE_NAME[NUM_STATES] = {
+	"REST", "BATCH", "YELLOW", "ALL_RED", "MIN_GREEN", "EXTENSION", "IDLE", "CHANGE", "GREEN"
+};
+
+typedef State (*Handler)(uint32_t arg, uint32_t now);
+typedef State (*Entry)(uint32_t now);
+
+/** @brief Deadlines of the current phase (ms, compared wrap-safe) */
+typedef struct {
+	uint32_t allocated;					// Initial GREEN the estimator allocated
+	uint32_t batchEnd;					// End of the batching window
+	uint32_t yellowEnd;					// End of the YELLOW of the stopped lights
+	uint32_t clearEnd;					// End of the all-red clearance - the phase turns GREEN
+	uint32_t greenInitialEnd;			// End of the initial GREEN interval
+	uint32_t greenMaxEnd;				// Max-out time
+	uint32_t lastExtension;				// Last detection on the phase
+	uint32_t laneClear[NUM_LIGHTS];		// Time the queue of each light of the phase has discharged
+	uint32_t waitingSince[NUM_PHASES];	// Time each waiting phase was called
+} PhaseTiming;
+
+static State state = ST_REST;
+static uint32_t phase = NUM_PHASES;		// Phase being released or served (CHANGE, GREEN)
+static uint32_t stopping = 0;			// Lights still to turn RED for `phase`
+static uint32_t queuedPhases = 0;		// Bitmask of the phases waiting for GREEN
+static uint32_t forced = NUM_PHASES;	// Phase to serve next whatever the policy
+static bool trace = false;				// Log every state transition
+static bool stopped = false;			// controller_stop() called - events are discarded
+static PhaseTiming timing;
+static ActuationStats actuation = {0};
+
+static void stateTimerExpired(void);
+static SoftTimer stateTimer = { .callback = stateTimerExpired };
+static uint32_t timerGeneration = 0;	// Bumped on every re-arm - older expiries are stale
+static volatile uint32_t timerMissed = 0;	// Generation of an expiry the full event ring refused (0: none)
+
+// Timer callback runs in the TIM2 interrupt - only record the expiry for the main loop
+static void stateTimerExpired(void) {
+	if (!event_push_value(EVENT_TIMER_EXPIRED, 0, systickGetMicros(), timerGeneration)) {
+		timerMissed = timerGeneration;		// Nothing re-arms the timer - the expiry must not be lost
+	}
+}
+
+static void stateTimerStart(uint32_t delay) {
+	timerGeneration++;
+	systick_timer_start(&stateTimer, delay);
+}
+
+// Add a phase to the waiting set once
+static void queuePhase(uint32_t phase, uint32_t now) {
+	if (queuedPhases & (1U << phase)) {
+		return;
+	}
+	queuedPhases |= (1U << phase);
+	timing.waitingSince[phase] = now;
+	phasePolicy->enqueue(phase, now);
+	LOG("Phase %s queued.", PHASES[phase].name);
+}
+
+// Choose the next waiting phase with the build-time policy, or -1 if none is waiting
+// A forced phase, then a phase waiting longer than MAX_PHASE_WAIT_MS, is served first whatever the policy
+static int32_t nextPhase(uint32_t now) {
+	if (queuedPhases == 0) {
+		return -1;
+	}
+
+	uint32_t phase = forced;
+	if (phase == NUM_PHASES) {
+		uint32_t longestWait = config.maxPhaseWait;
+		for (uint32_t p=0; p<NUM_PHASES; p++) {
+			if ((queuedPhases & (1U << p)) && now - timing.waitingSince[p] > longestWait) {
+				phase = p;
+				longestWait = now - timing.waitingSince[p];
+			}
+		}
+	}
+	if (phase == NUM_PHASES) {
+		phase = phasePolicy->select(queuedPhases, now);
+	}
+
+	forced = NUM_PHASES;
+	queuedPhases &= ~(1U << phase);
+	phasePolicy->served(phase, now);			// Whoever picked it - the policy's own state follows
+	return phase;
+}
+
+// Select a phase and stop the conflicting flow - YELLOW, or the clearance if nothing is moving
+static State changePhase(uint32_t next, uint32_t now) {
+	PROFILE_BEGIN(PROF_CHANGE_PHASE);
+	phase = next;
+
+	// Allocate the green time the most loaded light of the phase needs
+	timing.allocated = 0;
+	for (int i=0; i<NUM_LIGHTS; i++) {
+		if (PHASES[phase].lights & (1U<<i)) {
+			uint32_t need = estimator_green_time(&Light[i], now);
+			if (need > timing.allocated) {
+				timing.allocated = need;
+			}
 		}
 	}
+	LOG("Phase %s allocated timer: %ld", PHASES[phase].name, timing.allocated);
+
+	// The change interval is set by the slowest-clearing movement being stopped
+	stopping = lights_set_yellow(intersection_conflict_lights(phase));
+	Clearance clear = intersection_clearance(stopping);
+	uint32_t stopDelay = clear.yellow + clear.allRed;
+	timing.yellowEnd = now + clear.yellow;
+	timing.clearEnd = now + stopDelay;
+
+	// GREEN intervals run from the end of the clearance
+	timing.greenMaxEnd = timing.clearEnd + config.maxGreen;
+	timing.greenInitialEnd = timing.clearEnd + timing.allocated;
+	if ((int32_t)(timing.greenInitialEnd - timing.greenMaxEnd) > 0) {
+		timing.greenInitialEnd = timing.greenMaxEnd;
+	}
+	timing.lastExtension = now - config.passageTime;		// No extension until a vehicle is detected
 
-	if (waitForTimer && (systickGetMillis() - yellowStartTime >= 1000)) {
-		if (waitingLightPair == 0) {
-			lights_set_red(1, 3);
-			lights_set_green(0, 2);
-		} else if (waitingLightPair == 1) {
-			lights_set_red(0, 2);
-			lights_set_green(1, 3);
+	// Fold the released queue and occupancy into the estimates and reset car counts
+	for (int i=0; i<NUM_LIGHTS; i++) {
+		if (PHASES[phase].lights & (1U<<i)) {
+			timing.laneClear[i] = now + stopDelay + config.greenStartup + Light[i].carCount * config.greenExtension;
+			estimator_served(&Light[i], now);
+			stats_served(i, timing.clearEnd, now);
+			Light[i].carCount = 0;
 		}
+	}
+	PROFILE_END(PROF_CHANGE_PHASE);
+	return stopping ? ST_YELLOW : ST_ALL_RED;
+}
+
+// Give GREEN to the waiting phase chosen by the phase policy, or rest
+static State serveWaitingPhase(uint32_t now) {
+	int32_t next = nextPhase(now);
+	if (next == -1) {
+		LOG("Nothing to process.");
+		return ST_REST;
+	}
+	LOG("Processing phase %s.", PHASES[next].name);
+	return changePhase(next, now);
+}
 
-		waitForTimer = false;
-		waitingLightPair = -1;
-	}
-
-}
-
-// Handle the command to stop and release the flow of traffic for light change
-void changeLight(uint32_t lightA, uint32_t lightB) {
-	activeLightPair = lightA;	// Register the active light pair
-	uint32_t currentTime = systickGetMillis();
-
-	// Check which Light in the pair has higher carCount
-	int carNums = (Light[lightA].carCount > Light[lightB].carCount) ? Light[lightA].carCount : Light[lightB].carCount;
-	
-	// Allocate time based on car count
-	// 1 car = 2secs, 2 cars = 3secs, More than 3 = 5secs
-	allocatedTime = (carNums >= 3) ? 5 : (carNums == 2) ? 3 : 2;
-	LOG("Light %ld-%ld allocated timer: %ld", lightA+1, lightA+3, allocatedTime*1000);
-
-	// Start timer for the GREEN light duration - timer handled by checkGreenLightTimeout()
-	timerStartTime = systickGetMillis();
-	timerActive = true;
-
-	// Stop traffic for the current light pair and release for the next light pair
-    if (lightA == 0 || lightA == 2) {
-        if (lights_set_yellow(1, 3)) {				// Have to stop the current flow before releasing the next
-			yellowStartTime = systickGetMillis();
-			waitingLightPair = 0;
-			waitForTimer = true;
-			// LOG("Before delay\r\n");
-			// systickDelayMs(1000);
-			// LOG("After delay\r\n");
-			// if (stop(1, 3)) {
-			// 	LOG("Changed to YELLOW then RED\r\n");
-			// 	go(0, 2);					// If stop succesful, release the next flow
-			// }
-		} else {
-			LOG("Could not stop light 2-4.");
+// Batching window before an idle intersection serves its calls
+// Under light load it is zero, so a call is served as soon as it arrives. As the busiest
+// lane's mean arrival gap shrinks below BATCH_IDLE_GAP_MS the window grows towards
+// BATCH_WINDOW_MAX_MS, letting the phase policy choose among several calls.
+static uint32_t batchWindow(void) {
+	uint32_t gap = config.batchIdleGap;
+	for (int i=0; i<NUM_LIGHTS; i++) {
+		uint32_t lightGap = estimator_gap_ms(&Light[i]);
+		if (lightGap != 0 && lightGap < gap) {
+			gap = lightGap;
 		}
-    } else if (lightA == 1 || lightA == 3) {
-        if (lights_set_yellow(0, 2)) {				// Check stop first
-			yellowStartTime = systickGetMillis();
-			waitingLightPair = 1;
-			waitForTimer = true;
-			// systickDelayMs(1000);
-			// if (stop(0, 2)) {
-			// 	go(1, 3);					// Release on successful stop
-			// }
-		} else {
-			LOG("Could not stop light1-3");
+	}
+	return config.batchWindowMax * (config.batchIdleGap - gap) / config.batchIdleGap;
+}
+
+// Entry actions - arm the state timer, or pass on to the next state
+
+static State enterRest(uint32_t now) {
+	systick_timer_stop(&stateTimer);
+	return ST_REST;
+}
+
+static State enterBatch(uint32_t now) {
+	stateTimerStart(timing.batchEnd - now);
+	return ST_BATCH;
+}
+
+static State enterYellow(uint32_t now) {
+	stateTimerStart(timing.yellowEnd - now);
+	return ST_YELLOW;
+}
+
+static State releasePhase(uint32_t arg, uint32_t now);
+
+static State enterAllRed(uint32_t now) {
+	int32_t left = (int32_t)(timing.clearEnd - now);
+	if (left <= 0) {
+		return releasePhase(0, now);		// Nothing to clear - stop and release in the same output write
+	}
+	lights_set_phase(stopping, 0);
+	stopping = 0;
+	stateTimerStart((uint32_t)left);
+	return ST_ALL_RED;
+}
+
+static State enterMinGreen(uint32_t now) {
+	int32_t left = (int32_t)(timing.greenInitialEnd - now);
+	stateTimerStart(left > 0 ? (uint32_t)left : 0);
+	return ST_MIN_GREEN;
+}
+
+static State enterExtension(uint32_t now) {
+	uint32_t until = timing.lastExtension + config.passageTime;
+	if ((int32_t)(until - timing.greenMaxEnd) > 0) {
+		until = timing.greenMaxEnd;
+	}
+	stateTimerStart(until - now);
+	return ST_EXTENSION;
+}
+
+// Transition handlers - `arg` is the lane for SIG_DETECT
+
+// Place the calls of a detection on a RED phase right away, in detection order
+static State placeCall(uint32_t lane, uint32_t now) {
+	uint32_t light = DETECTOR_LIGHT[lane];
+	Light[light].carCount++;				// Increment car count
+	stats_queued(light, (uint32_t)Light[light].carCount, now);
+	LOG("Light %ld car detected: %d", light+1, Light[light].carCount);
+
+	uint32_t calls = intersection_detector_phases(lane);
+	for (uint32_t p=0; calls != 0; p++, calls >>= 1) {
+		if (calls & 1U) {
+			queuePhase(p, now);
 		}
-    }
-	// Reset car counts
-    Light[lightA].carCount = 0;			
-    Light[lightB].carCount = 0;			
-}
-
-// Station 2
-// Allow 3 seconds for user button input - Prevent processing after first press
-// Function periodically invoked by SysTick_Handler to determine if 3secs window elapsed
-void SysTick_CheckFirstPressTimeout(void) {
-	uint32_t currentTime = systickGetMillis();
-
-	/* Button press = Car detected
-	** When more than 1 button pressed at once (ie cars detected at more than 1 Light),
-	** queue the request such that the first button press is processed first.
-	*/
-	if (firstPress && (currentTime - firstPressTime >= 3000)) {
-		
-		// Determine which pairs need to be queued first
-		if (firstPair == 0 || firstPair == 2) {				// If Light 1 or 3
-			queue_enqueue(0);										// Queue Light pair 1-3
-			LOG("Light 1-3 queued.");
-			if (secondPair != -1) {							// Check if second pair requested
-				queue_enqueue(1);									// Queue Light pair 2-4
-				LOG("Light 2-4 queued.");
+	}
+	return ST_STAY;
+}
+
+// Idle intersection - serve now, or gather calls for the adaptive window
+static State restDetect(uint32_t lane, uint32_t now) {
+	placeCall(lane, now);
+
+	uint32_t window = batchWindow();
+	if (window == 0) {
+		return serveWaitingPhase(now);
+	}
+	timing.batchEnd = now + window;
+	return ST_BATCH;
+}
+
+static State batchTimeout(uint32_t arg, uint32_t now) {
+	return serveWaitingPhase(now);
+}
+
+// A vehicle on the selected phase extends its green instead of placing a call
+static State phaseDetect(uint32_t lane, uint32_t now) {
+	if (!(intersection_detector_phases(lane) & (1U << phase))) {
+		return placeCall(lane, now);
+	}
+
+	uint32_t light = DETECTOR_LIGHT[lane];
+	timing.lastExtension = now;
+	LOG("Light %ld car detected: extending phase %s", light+1, PHASES[phase].name);
+
+	// Inside the initial interval the vehicle joins the discharging queue - hold the
+	// GREEN until it clears if the allocated time does not already cover it
+	if ((int32_t)(timing.greenInitialEnd - now) > 0) {
+		if ((int32_t)(timing.laneClear[light] - now) < 0) {
+			timing.laneClear[light] = now;
+		}
+		timing.laneClear[light] += config.greenExtension;
+		if ((int32_t)(timing.laneClear[light] - timing.greenInitialEnd) > 0) {
+			timing.greenInitialEnd = timing.laneClear[light];
+			if ((int32_t)(timing.greenInitialEnd - timing.greenMaxEnd) > 0) {
+				timing.greenInitialEnd = timing.greenMaxEnd;
 			}
-		} else if (firstPair == 1 || firstPair == 3) {		// If Light 2 or 4
-			queue_enqueue(1);
-			LOG("Light 2-4 queued.");
-			if (secondPair != -1) {							// Check if second pair requested
-				queue_enqueue(0);
-				LOG("Light 1-3 queued.");
+			if (state == ST_MIN_GREEN) {
+				return ST_MIN_GREEN;			// Re-arm for the later end
 			}
 		}
+	}
+	return ST_STAY;
+}
 
-		// Process the first request in the queue
-		uint32_t processPair = queue_dequeue();
-		if (processPair != -1) {
-			LOG("Processing Light %ld-%ld.", processPair+1, processPair+3);
-			changeLight(processPair, processPair+2);
-		} else {
-			LOG("Nothing to process.");
+static State yellowTimeout(uint32_t arg, uint32_t now) {
+	return ST_ALL_RED;
+}
+
+// Clearance over - the stopped lights turn RED and the phase GREEN in one write
+static State releasePhase(uint32_t arg, uint32_t now) {
+	lights_set_phase(stopping, PHASES[phase].lights);
+	stopping = 0;
+	return ST_MIN_GREEN;
+}
+
+// Extend the phase while vehicles keep arriving, otherwise serve the queue
+static State greenTimeout(uint32_t arg, uint32_t now) {
+	// A detection within the passage time keeps the phase GREEN, up to the maximum
+	StatsEnd reason;
+	if (forced != NUM_PHASES) {
+		reason = STATS_FORCED;
+		LOG("Phase %s ended for forced phase %s", PHASES[phase].name, PHASES[forced].name);
+	} else if (now - timing.lastExtension < config.passageTime) {
+		if ((int32_t)(timing.greenMaxEnd - now) > 0) {
+			return ST_EXTENSION;
 		}
+		reason = STATS_MAX_OUT;
+		actuation.maxOut++;
+		LOG("Phase %s max-out", PHASES[phase].name);
+	} else {
+		reason = STATS_GAP_OUT;
+		actuation.gapOut++;
+		LOG("Phase %s gap-out", PHASES[phase].name);
+	}
+	stats_green_end(PHASES[phase].lights, now - timing.clearEnd, reason, now);
 
-		// Reset after processing
-		firstPress = false;		
-		firstPair = -1;				
-		secondPair = -1;
-	}
-}
-
-// Station 1
-// Button input for car detection - Handle button press
-void EXTI15_10_IRQHandler(void) {
-	static uint32_t lastPressTime[BUTTONS] = {0};
-	uint32_t currentTime = systickGetMillis();
-
-	for (int i=0; i<BUTTONS; i++) {
-		if ((EXTI->PR & BUTTON[i]) != 0) {
-			// Check if after 100ms - Prevent debounce that result in consecutive presses
-			if (currentTime - lastPressTime[i] >= DEBOUNCE_TIME) {
-				lastPressTime[i] = currentTime;  	// Update last press time
-				Light[i].carCount++;				// Increment car count
-				LOG("Light %d car detected: %d", i+1, Light[i].carCount);
-
-				// Record details of the first press - Use it to create 3secs delay to allow for user button input
-				if (!firstPress) {					// If this is the first press this round
-					firstPressTime = currentTime;	// Record the time of the first press
-					firstPress = true;				// Place us in the waiting period
-					firstPair = i;					// Record the first button press
-				} else {
-					if ((firstPair == 0 || firstPair == 2) && (i == 1 || i == 3)) {
-						secondPair = i;
-					}
-					else if ((firstPair == 1 || firstPair == 3) && (i == 0 || i == 2)) {
-						secondPair = i;
-					}
-				}
-			}
-			EXTI->PR |= BUTTON[i];		// Clear interrupt (PR) flag
+	LOG("Allocated time finished - Timer released\r\n");
+	phase = NUM_PHASES;
+	return serveWaitingPhase(now);
+}
+
+// Operator override - serve `forcedPhase` next whatever the policy
+static State forceCall(uint32_t forcedPhase, uint32_t now) {
+	LOG("Phase %s forced.", PHASES[forcedPhase].name);
+	forced = forcedPhase;
+	queuePhase(forcedPhase, now);
+	return ST_STAY;
+}
+
+// Idle intersection - change at once, even inside the batching window
+static State forceIdle(uint32_t forcedPhase, uint32_t now) {
+	forceCall(forcedPhase, now);
+	return serveWaitingPhase(now);
+}
+
+// Running phase - keep the clearance and minimum GREEN, but stop extending
+static State forceRunning(uint32_t forcedPhase, uint32_t now) {
+	if (forcedPhase == phase) {
+		LOG("Phase %s already selected.", PHASES[phase].name);
+		return ST_STAY;
+	}
+	forceCall(forcedPhase, now);
+	return (state == ST_EXTENSION) ? greenTimeout(0, now) : ST_STAY;
+}
+
+static const State PARENT[NUM_STATES] = {
+	[ST_REST]      = ST_IDLE,	[ST_BATCH]     = ST_IDLE,
+	[ST_YELLOW]    = ST_CHANGE,	[ST_ALL_RED]   = ST_CHANGE,
+	[ST_MIN_GREEN] = ST_GREEN,	[ST_EXTENSION] = ST_GREEN,
+	[ST_IDLE]      = ST_IDLE,	[ST_CHANGE]    = ST_CHANGE,	[ST_GREEN] = ST_GREEN,
+};
+
+static const Entry ENTRY[NUM_STATES] = {
+	[ST_REST]      = enterRest,
+	[ST_BATCH]     = enterBatch,
+	[ST_YELLOW]    = enterYellow,
+	[ST_ALL_RED]   = enterAllRed,
+	[ST_MIN_GREEN] = enterMinGreen,
+	[ST_EXTENSION] = enterExtension,
+};
+
+static const Handler TRANSITIONS[NUM_STATES][NUM_SIGNALS] = {
+	//				  SIG_DETECT		SIG_TIMER			SIG_FORCE
+	[ST_REST]      = { restDetect,		NULL,				NULL },
+	[ST_BATCH]     = { NULL,			batchTimeout,		NULL },
+	[ST_YELLOW]    = { NULL,			yellowTimeout,		NULL },
+	[ST_ALL_RED]   = { NULL,			releasePhase,		NULL },
+	[ST_MIN_GREEN] = { NULL,			greenTimeout,		NULL },
+	[ST_EXTENSION] = { NULL,			greenTimeout,		NULL },
+	[ST_IDLE]      = { placeCall,		NULL,				forceIdle },
+	[ST_CHANGE]    = { phaseDetect,		NULL,				forceRunning },
+	[ST_GREEN]     = { phaseDetect,		NULL,				forceRunning },
+};
+
+// Run the handler of a signal in the current state and enter the state it returns
+static void dispatch(Signal sig, uint32_t arg, uint32_t now) {
+	Handler handler = TRANSITIONS[state][sig];
+	if (handler == NULL) {
+		handler = TRANSITIONS[PARENT[state]][sig];
+	}
+	if (handler == NULL) {
+		return;
+	}
+
+	State next = handler(arg, now);
+	while (next != ST_STAY) {
+		if (trace) {
+			LOG("[%lu] %s -> %s", now, STATE_NAME[state], STATE_NAME[next]);
+		}
+		state = next;
+		next = ENTRY[state](now);
+		next = (next == state) ? ST_STAY : next;
+	}
+}
+
+// No phase running, stopping traffic or waiting to be served
+bool controller_idle(void) {
+	return state == ST_REST;
+}
+
+/** @brief Name of the current leaf state */
+const char *controller_state_name(void) {
+	return STATE_NAME[state];
+}
+
+/** @brief Phase being released or served, NUM_PHASES when idle */
+uint32_t controller_phase(void) {
+	return phase;
+}
+
+/**
+ * @brief Have `phase` served next, ahead of the phase policy.
+ *
+ * Only queues the request; the main loop applies it with the other events.
+ *
+ * @return false if `phase` is out of range or the event queue is full
+*/
+bool controller_force_phase(uint32_t phase) {
+	if (phase >= NUM_PHASES) {
+		return false;
+	}
+	return event_push(EVENT_PHASE_FORCED, (uint8_t)phase, systickGetMicros());
+}
+
+/** @brief Log every state transition while `on` */
+void controller_set_trace(bool on) {
+	trace = on;
+}
+
+/**
+ * @brief Stop the control logic for good - the outputs are left to the monitor.
+ *
+ * Pending and later events are discarded so the main loop can still sleep.
+*/
+void controller_stop(void) {
+	stopped = true;
+	systick_timer_stop(&stateTimer);
+}
+
+/** @brief Gap-out and max-out terminations since reset */
+const ActuationStats *controller_get_actuation_stats(void) {
+	return &actuation;
+}
+
+/**
+ * @brief Run the control logic for every event captured since the last call.
+ *
+ * Called from the main loop after each wake-up. All controller state is
+ * only touched here, so interrupt handlers and control logic never race.
+*/
+void controller_process_events(void) {
+	PROFILE_BEGIN(PROF_EVENTS);
+	Event ev;
+
+	while (event_pop(&ev)) {
+		uint32_t now = (uint32_t)(ev.timestamp / 1000U);	// Control logic runs on milliseconds
+
+		if (stopped) {
+			continue;
+		} else if (ev.type == EVENT_VEHICLE_DETECTED) {
+			estimator_arrival(&Light[DETECTOR_LIGHT[ev.id]], now);
+			stats_detection(DETECTOR_LIGHT[ev.id], now);
+			dispatch(SIG_DETECT, ev.id, now);
+		} else if (ev.type == EVENT_VEHICLE_RELEASED) {
+			estimator_departure(&Light[DETECTOR_LIGHT[ev.id]], now);
+		} else if (ev.type == EVENT_TIMER_EXPIRED && ev.value == timerGeneration) {
+			dispatch(SIG_TIMER, 0, now);
+		} else if (ev.type == EVENT_PHASE_FORCED) {
+			dispatch(SIG_FORCE, ev.id, now);
 		}
 	}
-}
\ No newline at end of file
+
+	// An expiry the ring refused came after every event it held
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	uint32_t missed = timerMissed;
+	timerMissed = 0;
+	__set_PRIMASK(primask);
+	if (missed != 0 && missed == timerGeneration && !stopped) {
+		dispatch(SIG_TIMER, 0, systickGetMillis());
+	}
+	PROFILE_END(PROF_EVENTS);
+}
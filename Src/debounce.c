@@ -0,0 +1,202 @@
+/**
+ * @file debounce.c
+ * @brief Sampled, bit-parallel debounce filter for the detector inputs.
+ *
+ * A detector edge no longer costs one interrupt per contact bounce. The
+ * first edge masks the detector EXTI lines and starts sampling the whole
+ * GPIOC input register every DEBOUNCE_SAMPLE_MS. Each sample runs through
+ * a vertical counter: bit n of `cnt0..cnt2` is the 3-bit counter of lane
+ * n, so all lanes are filtered at once with a handful of logic operations.
+ * A lane's debounced state changes once its input has differed from it on
+ * the lane's configured number of consecutive samples; anything shorter
+ * is rejected as a bounce.
+ *
+ * When every input agrees with its debounced state the sampling timer
+ * stops and the EXTI lines are unmasked, so an idle intersection still
+ * takes no periodic interrupts.
+ *
+ * Accepted changes are pushed to the event queue, stamped with the time
+ * of the first sample of the stable run: EVENT_VEHICLE_DETECTED on press,
+ * EVENT_VEHICLE_RELEASED on release with the occupancy duration.
+ *
+ * @note Runs from EXTI15_10_IRQHandler() and the TIM2 timer callback. Both
+ * 		 interrupts share one priority, so they never preempt each other.
+*/
+
+#include "event.h"
+#include "latency.h"
+#include "profile.h"
+#include "systick.h"
+#include "debounce.h"
+#include "controller.h"
+#include "intersection.h"
+
+#define LANES			((1U << BUTTONS) - 1U)
+
+_Static_assert(BUTTON_PINS == (LANES << BUTTON_SHIFT), "Detector inputs must be contiguous pins");
+_Static_assert(BUTTONS <= 32, "Lanes must fit one word");
+
+static uint32_t state = 0;					// Debounced presence, bit n = lane n
+static uint32_t running = 0;				// Lanes that differed from `state` at the last sample
+static uint32_t cnt0, cnt1, cnt2;			// Vertical counter - further samples needed, per lane
+static uint32_t reload0, reload1, reload2;	// Counter start value (samples - 1), per lane
+static uint64_t runStart[BUTTONS];			// Time of the first sample of the current run
+static uint64_t pressTime[BUTTONS];			// Time each lane was last accepted as occupied
+
+static void sampleTimerExpired(void);
+
+static SoftTimer sampleTimer = { .callback = sampleTimerExpired };	// Sampling period while inputs change
+
+/** @brief Occupied detectors as lane bits (inputs are active low) */
+static inline uint32_t read_lanes(void) {
+	return (~GPIOC->IDR & BUTTON_PINS) >> BUTTON_SHIFT;
+}
+
+/** @brief Push an event for every lane whose debounced state just changed */
+static void report(uint32_t changed) {
+	while (changed) {
+		uint32_t lane = (uint32_t)__builtin_ctz(changed);
+		changed &= changed - 1U;
+
+		uint64_t t = runStart[lane];
+		if (state & (1U << lane)) {
+			pressTime[lane] = t;
+			event_push(EVENT_VEHICLE_DETECTED, lane, t);
+		} else {
+			event_push_value(EVENT_VEHICLE_RELEASED, lane, t, (uint32_t)(t - pressTime[lane]));
+		}
+	}
+}
+
+/**
+ * @brief Take one sample of every detector and advance the filter.
+ *
+ * @param now Sample time in microseconds
+ * @return true while an input still differs from its debounced state
+*/
+static bool sample(uint64_t now) {
+	uint32_t delta = read_lanes() ^ state;
+
+	// Remember where each new run of differing samples began
+	for (uint32_t started = delta & ~running; started; started &= started - 1U) {
+		runStart[__builtin_ctz(started)] = now;
+	}
+	running = delta;
+
+	// A lane whose counter has run down and still differs has been stable long enough
+	uint32_t expired = delta & ~(cnt0 | cnt1 | cnt2);
+
+	// Decrement every counter at once
+	uint32_t borrow1 = ~cnt0;
+	uint32_t borrow2 = borrow1 & ~cnt1;
+	cnt0 = ~cnt0;
+	cnt1 ^= borrow1;
+	cnt2 ^= borrow2;
+
+	// Lanes back at their debounced state, or just accepted, start over
+	uint32_t reload = ~delta | expired;
+	cnt0 = (cnt0 & ~reload) | (reload0 & reload);
+	cnt1 = (cnt1 & ~reload) | (reload1 & reload);
+	cnt2 = (cnt2 & ~reload) | (reload2 & reload);
+
+	state ^= expired;
+	running &= ~expired;
+	report(expired);
+
+	return (delta & ~expired) != 0;
+}
+
+/** @brief Sample, then keep sampling or go back to waiting for an edge */
+static void track(uint64_t now) {
+	if (!sample(now)) {
+		EXTI->PR = BUTTON_PINS;				// Drop edges latched while sampling
+		EXTI->IMR |= BUTTON_PINS;
+		if (read_lanes() == state) {
+			return;							// Idle until the next edge
+		}
+		EXTI->IMR &= ~BUTTON_PINS;			// Changed while unmasking - keep sampling
+	}
+	systick_timer_start(&sampleTimer, DEBOUNCE_SAMPLE_MS);
+}
+
+static void sampleTimerExpired(void) {
+	track(systickGetMicros());
+}
+
+/**
+ * @brief Detector edge interrupt - starts sampling.
+ *
+ * Only the first edge of a change interrupts; the detector lines stay
+ * masked until every input is stable again.
+*/
+void EXTI15_10_IRQHandler(void) {
+	uint64_t now = systickGetMicros();		// Latch the edge time first - microsecond resolution
+	PROFILE_BEGIN(PROF_EXTI);
+	LATENCY_EXTI(now);
+
+	EXTI->IMR &= ~BUTTON_PINS;				// Bounces are seen by sampling from here on
+	EXTI->PR = BUTTON_PINS;					// Clear the pending flags (write 1 to clear)
+	track(now);
+	PROFILE_END(PROF_EXTI);
+}
+
+/**
+ * @brief Set how many consecutive samples a lane needs to accept a change.
+ *
+ * The debounce time of the lane is `samples * DEBOUNCE_SAMPLE_MS`; pulses
+ * or gaps shorter than that are ignored.
+ *
+ * @param lane 		Detector index
+ * @param samples 	1 to DEBOUNCE_SAMPLES_MAX, clamped
+*/
+void debounce_set_samples(uint32_t lane, uint32_t samples) {
+	if (lane >= BUTTONS) {
+		return;
+	}
+	if (samples < 1) {
+		samples = 1;
+	} else if (samples > DEBOUNCE_SAMPLES_MAX) {
+		samples = DEBOUNCE_SAMPLES_MAX;
+	}
+
+	uint32_t bit = 1U << lane;
+	uint32_t value = samples - 1U;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	reload0 = (reload0 & ~bit) | ((value & 1U) ? bit : 0);
+	reload1 = (reload1 & ~bit) | ((value & 2U) ? bit : 0);
+	reload2 = (reload2 & ~bit) | ((value & 4U) ? bit : 0);
+	__set_PRIMASK(primask);
+}
+
+/**
+ * @brief Load the per-lane sample counts and the current input state.
+ *
+ * Call after exti_init() and systick_init(). Lanes occupied at start-up
+ * are taken as the initial state and do not produce a press event.
+*/
+void debounce_init(void) {
+	for (uint32_t lane = 0; lane < BUTTONS; lane++) {
+		debounce_set_samples(lane, DETECTOR_DEBOUNCE[lane]);
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	cnt0 = reload0;
+	cnt1 = reload1;
+	cnt2 = reload2;
+	running = 0;
+	state = read_lanes();
+	__set_PRIMASK(primask);
+}
+
+/** @brief true while the filter is sampling - detector edges are then not interrupting */
+bool debounce_busy(void) {
+	return sampleTimer.armed;
+}
+
+/** @brief Debounced detector presence, bit n = lane n occupied */
+uint32_t debounce_state(void) {
+	return state;
+}
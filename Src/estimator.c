@@ -0,0 +1,174 @@
+/**
+ * @file estimator.c
+ * @brief Per-lane arrival-rate, queue and occupancy estimator for adaptive green time.
+ *
+ * Each TrafficLight keeps three exponentially weighted moving averages in
+ * integer fixed point (the build uses a soft-float ABI, so no FPU code):
+ * 	- `gapAvg`: mean inter-arrival gap in ms, Q4 (1/16 ms)
+ * 	- `queueAvg`: vehicles waiting when the light turns GREEN, Q8
+ * 	- `occupancyAvg`: fraction of each cycle the detector was occupied, Q8
+ *
+ * Each is updated in O(1) with a shift instead of a divide. Occupancy is
+ * timed from the detector's press and release edges; a cycle runs from one
+ * GREEN of the light to the next. The green time
+ * needed to clear a queue `q` with start-up lost time `L`, headway `h` and
+ * mean arrival gap `g` (vehicles keep arriving while it discharges) is
+ *
+ * 		G = (L + q * h) * g / (g - h)
+ *
+ * clamped to [greenMin, greenMax] (config.h, defaults GREEN_MIN_MS and
+ * GREEN_MAX_MS). Once arrivals come as fast as
+ * the queue discharges (g <= h) the lane is saturated and gets GREEN_MAX_MS.
+ *
+ * Pulse counts miss vehicles standing over the detector, so occupancy `o`
+ * above the free-flow level F stretches the result the same way, by
+ * (C - F) / (C - o) with C the congested level; a congested lane
+ * (o >= OCCUPANCY_CONGESTED) gets GREEN_MAX_MS.
+*/
+
+#include "config.h"
+#include "estimator.h"
+
+#define Q4			4
+#define Q8			8
+
+#define OCCUPANCY_FREE_Q8		((OCCUPANCY_FREE << Q8) / 100)
+#define OCCUPANCY_CONGESTED_Q8	((OCCUPANCY_CONGESTED << Q8) / 100)
+
+/**
+ * @brief Feed a debounced detection into the rate estimate.
+ *
+ * @param light Light the detector sits in front of
+ * @param now   Detection timestamp in milliseconds
+*/
+void estimator_arrival(TrafficLight *light, uint32_t now) {
+	uint32_t gap = now - light->lastArrival;
+	if (gap > ARRIVAL_GAP_MAX_MS) {
+		gap = ARRIVAL_GAP_MAX_MS;
+	}
+	light->lastArrival = now;
+
+	light->occupied = true;
+	light->occupiedSince = now;
+
+	if (light->gapAvg == 0) {
+		light->gapAvg = ARRIVAL_GAP_MAX_MS << Q4;			// No gap yet - start from an idle lane
+		return;
+	}
+	int32_t err = (int32_t)(gap << Q4) - (int32_t)light->gapAvg;
+	light->gapAvg += err >> EWMA_SHIFT;						// Arithmetic shift keeps the sign
+}
+
+/**
+ * @brief Detector released - add the presence to the cycle's occupied time.
+ *
+ * @param light Light the detector sits in front of
+ * @param now   Release timestamp in milliseconds
+*/
+void estimator_departure(TrafficLight *light, uint32_t now) {
+	if (!light->occupied) {
+		return;
+	}
+	if ((int32_t)(now - light->occupiedSince) > 0) {
+		light->occupiedMs += now - light->occupiedSince;
+	}
+	light->occupied = false;
+}
+
+/** @brief Occupancy of the cycle so far, Q8 ratio, counting a presence still in progress */
+static uint32_t cycle_occupancy(const TrafficLight *light, uint32_t now) {
+	uint32_t occupied = light->occupiedMs;
+	if (light->occupied && (int32_t)(now - light->occupiedSince) > 0) {
+		occupied += now - light->occupiedSince;
+	}
+
+	uint32_t cycle = now - light->cycleStart;
+	if (cycle == 0) {
+		return 0;							// Cycle just started - nothing measured yet
+	}
+	if (occupied >= cycle) {
+		return 1U << Q8;
+	}
+	return (uint32_t)(((uint64_t)occupied << Q8) / cycle);
+}
+
+/**
+ * @brief Fold the queue and occupancy of the ending cycle into the estimates.
+ *
+ * Called when the light's phase is given GREEN, before `carCount` is reset.
+ * Starts the next occupancy cycle.
+*/
+void estimator_served(TrafficLight *light, uint32_t now) {
+	int32_t err = (int32_t)((uint32_t)light->carCount << Q8) - (int32_t)light->queueAvg;
+	light->queueAvg += err >> EWMA_SHIFT;
+
+	err = (int32_t)cycle_occupancy(light, now) - (int32_t)light->occupancyAvg;
+	light->occupancyAvg += err >> EWMA_SHIFT;
+
+	light->occupiedMs = 0;
+	light->occupiedSince = now;				// A vehicle still present is timed from here
+	light->cycleStart = now;
+}
+
+/**
+ * @brief Detector occupancy used for the light's green time, Q8 ratio.
+ *
+ * The larger of the current cycle so far and the smoothed occupancy, so a
+ * queue building up over the detector is seen before the cycle ends.
+*/
+uint32_t estimator_occupancy(const TrafficLight *light, uint32_t now) {
+	uint32_t occupancy = cycle_occupancy(light, now);
+	return occupancy > light->occupancyAvg ? occupancy : light->occupancyAvg;
+}
+
+/**
+ * @brief Green time (ms) needed to clear the light's estimated queue.
+ *
+ * The queue is the larger of the vehicles counted since the last GREEN and
+ * the smoothed queue, so one missed detection does not cut the green short.
+*/
+uint32_t estimator_green_time(const TrafficLight *light, uint32_t now) {
+	uint32_t queue = (light->queueAvg + (1U << (Q8 - 1))) >> Q8;	// Round to whole vehicles
+	if ((uint32_t)light->carCount > queue) {
+		queue = light->carCount;
+	}
+
+	uint32_t green = config.greenStartup + queue * config.greenExtension;
+	if (green >= config.greenMax) {
+		return config.greenMax;
+	}
+
+	// Stretch for arrivals during the discharge: g / (g - h)
+	// green < greenMax <= 60000 (CONFIG_PARAMS) and gap <= ARRIVAL_GAP_MAX_MS, so the product fits 32 bits
+	if (light->gapAvg != 0) {
+		uint32_t gap = light->gapAvg >> Q4;
+		if (gap <= config.greenExtension) {
+			return config.greenMax;						// Saturated
+		}
+		green = green * gap / (gap - config.greenExtension);
+		if (green >= config.greenMax) {
+			return config.greenMax;
+		}
+	}
+
+	// Stretch for vehicles standing over the detector: (C - F) / (C - o)
+	uint32_t occupancy = estimator_occupancy(light, now);
+	if (occupancy >= OCCUPANCY_CONGESTED_Q8) {
+		return config.greenMax;						// Congested
+	}
+	if (occupancy > OCCUPANCY_FREE_Q8) {
+		green = green * (OCCUPANCY_CONGESTED_Q8 - OCCUPANCY_FREE_Q8) / (OCCUPANCY_CONGESTED_Q8 - occupancy);
+	}
+
+	if (green < config.greenMin) {
+		green = config.greenMin;
+	} else if (green > config.greenMax) {
+		green = config.greenMax;
+	}
+	return green;
+}
+
+/** @brief Smoothed inter-arrival gap of the light in ms (0 = no detection yet) */
+uint32_t estimator_gap_ms(const TrafficLight *light) {
+	return light->gapAvg >> Q4;
+}
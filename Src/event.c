@@ -0,0 +1,67 @@
+/**
+ * @file event.c
+ * @brief Event queue between interrupt handlers and the main loop.
+ *
+ * Interrupt handlers only capture what happened and when; the control
+ * logic runs in the main loop, which drains this queue after every
+ * wake-up. Handlers of any priority may push (see RING_MPSC_DEFINE), and
+ * the main loop is the only consumer.
+*/
+
+#include "event.h"
+#include "stm32f446xx.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+EventQueue controllerEvents;
+
+/**
+ * @brief Append an event to the queue (producer side).
+ *
+ * Never blocks. If the queue is full the event is counted as dropped.
+ *
+ * @param type 		Event type
+ * @param id 		Lane index or timer id
+ * @param timestamp Capture time in microseconds
+ * @return true if the event was queued
+*/
+bool event_push(EventType type, uint8_t id, uint64_t timestamp) {
+	return event_push_value(type, id, timestamp, 0);
+}
+
+/**
+ * @brief Append an event carrying a value (producer side).
+ *
+ * @param type 		Event type
+ * @param id 		Lane index or timer id
+ * @param timestamp Capture time in microseconds
+ * @param value 	Event-specific value, e.g. occupancy of a release
+ * @return true if the event was queued
+*/
+bool event_push_value(EventType type, uint8_t id, uint64_t timestamp, uint32_t value) {
+	Event ev = { .type = (uint8_t)type, .id = id, .value = value, .timestamp = timestamp };
+	return event_ring_push(&controllerEvents, &ev) == RING_OK;
+}
+
+/**
+ * @brief Remove the oldest event (consumer side).
+ *
+ * Events are returned in the order they were captured.
+ *
+ * @param ev 	Destination for the event
+ * @return true if an event was returned
+*/
+bool event_pop(Event *ev) {
+	return event_ring_pop(&controllerEvents, ev) == RING_OK;
+}
+
+/** @brief Check whether the queue holds an unprocessed event */
+bool event_pending(void) {
+	return !event_ring_empty(&controllerEvents);
+}
+
+/** @brief Events lost because the queue was full */
+uint32_t event_dropped(void) {
+	return controllerEvents.dropped;
+}
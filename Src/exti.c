@@ -7,17 +7,26 @@
 */
 
 #include "exti.h"
+#include "pinmap.h"
 #include "stm32f446xx.h"
 
 #define GPIOCEN		(1U<<2)
 #define SYSCFGEN	(1U<<14)
 
+/** @brief Detector lines must all be served by EXTI15_10_IRQHandler() */
+_Static_assert((PINMAP_DETECTOR_PINS & ~(0x3FU << 10)) == 0, "Detectors must be on EXTI lines 10-15");
+
 /**
  * @brief Initializes external interrupt inputs for vehicle detection buttons.
  * 
- * This function configures GPIOC pins PC10–PC13 as input signals with
- * internal pull-up resistors and maps them to EXTI lines 10–13. 
- * Falling edge triggers are enabled to detect button press events.
+ * This function configures the detector pins of the pin map (GPIOC
+ * PC10–PC13 on this board) as input signals with internal pull-up
+ * resistors and maps them to their EXTI lines. 
+ * Falling and rising edge triggers are enabled so both press and release
+ * start the debounce filter (debounce.c).
+ * 
+ * Every register value is computed from the pin map at compile time, so
+ * each register is written once.
  * 
  * The EXTI lines are unmasked and routed through the NVIC using the
  * EXTI15_10 interrupt channel.
@@ -31,42 +40,25 @@ void exti_init(void) {
 
 	RCC->AHB1ENR |= GPIOCEN;	    // Enable clock for GPIOC
 
-	GPIOC->MODER &= ~(1U<<20);		// PC10 input mode - BUTTON1
-	GPIOC->MODER &= ~(1U<<21);
-	GPIOC->PUPDR &= ~(1U<<21);  	// Clear bit 21
-	GPIOC->PUPDR |= (1U<<20);   	// Enable pull-up resistor (01)
-
-	GPIOC->MODER &= ~(1U<<22);		// PC11 input mode - BUTTON2
-	GPIOC->MODER &= ~(1U<<23);
-	GPIOC->PUPDR &= ~(1U<<23);  	// Clear bit 23
-	GPIOC->PUPDR |= (1U<<22);   	// Enable pull-up resistor (01)
-
-	GPIOC->MODER &= ~(1U<<24);		// PC12 input mode - BUTTON3
-	GPIOC->MODER &= ~(1U<<25);
-	GPIOC->PUPDR &= ~(1U<<25);  	// Clear bit 25
-	GPIOC->PUPDR |= (1U<<24);   	// Enable pull-up resistor (01)
-
-	GPIOC->MODER &= ~(1U<<26);		// PC13 input mode - BUTTON4
-	GPIOC->MODER &= ~(1U<<27);
-	GPIOC->PUPDR &= ~(1U<<27);  	// Clear bit 27
-	GPIOC->PUPDR |= (1U<<26);   	// Enable pull-up resistor (01)
+	GPIOC->MODER = (GPIOC->MODER & ~PINMAP_FIELD2(PINMAP_DETECTOR_PINS, 3U))
+			| PINMAP_FIELD2(PINMAP_DETECTOR_PINS, GPIO_MODE_INPUT);		// Input mode
+	GPIOC->PUPDR = (GPIOC->PUPDR & ~PINMAP_FIELD2(PINMAP_DETECTOR_PINS, 3U))
+			| PINMAP_FIELD2(PINMAP_DETECTOR_PINS, GPIO_PULL_UP);		// Pull-up (01)
 
 	RCC->APB2ENR |= SYSCFGEN;		// Enable clock access to SYSCFG
 
-	SYSCFG->EXTICR[2] |= (1U<<9);	// Select PORTC for EXTI10
-	SYSCFG->EXTICR[2] |= (1U<<13);	// Select PORTC for EXTI11
-	SYSCFG->EXTICR[3] |= (1U<<1);	// Select PORTC for EXTI12
-	SYSCFG->EXTICR[3] |= (1U<<5);	// Select PORTC for EXTI13
-
-	EXTI->IMR |= (1u<<10);			// Unmask EXTI10
-	EXTI->IMR |= (1u<<11);			// Unmask EXTI11
-	EXTI->IMR |= (1u<<12);			// Unmask EXTI12
-	EXTI->IMR |= (1u<<13);			// Unmask EXTI13
+	// Route the detector lines to their port - only the EXTICR registers holding one
+	for (uint32_t reg = 0; reg < 4; reg++) {
+		uint32_t mask = PINMAP_EXTICR(PINMAP_DETECTOR_PINS, reg, 0xFU);
+		if (mask) {
+			SYSCFG->EXTICR[reg] = (SYSCFG->EXTICR[reg] & ~mask)
+					| PINMAP_EXTICR(PINMAP_DETECTOR_PINS, reg, PINMAP_DETECTOR_PORT);
+		}
+	}
 
-	EXTI->FTSR |= (1U<<10);			// Select falling edge trigger
-	EXTI->FTSR |= (1U<<11);
-	EXTI->FTSR |= (1U<<12);
-	EXTI->FTSR |= (1U<<13);
+	EXTI->IMR |= PINMAP_DETECTOR_PINS;		// Unmask the detector lines
+	EXTI->FTSR |= PINMAP_DETECTOR_PINS;		// Select falling edge trigger (press)
+	EXTI->RTSR |= PINMAP_DETECTOR_PINS;		// Select rising edge trigger (release)
 
 	NVIC_EnableIRQ(EXTI15_10_IRQn);	// Enable EXTI 10-15 lines in NVIC
 
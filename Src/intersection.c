@@ -0,0 +1,151 @@
+/**
+ * @file intersection.c
+ * @brief Phase table and conflict matrix for the intersection.
+ *
+ * The default layout is the four-way crossing of the original design:
+ * lights 1/3 (phase "1-3") and lights 2/4 (phase "2-4"), each light with
+ * its own detector. A protected left turn is added by giving it its own
+ * phase entry and marking the crossing movements in PHASE_CONFLICTS.
+ *
+ * Lookup tables derived from the phase table are built once by
+ * intersection_init(), so each detection or phase change costs O(phases).
+ * The YELLOW and all-red of each phase are computed there from its
+ * approach speed and the width it has to clear.
+*/
+
+#include "uart.h"
+#include "lights.h"
+#include "debounce.h"
+#include "monitor.h"
+#include "controller.h"
+#include "intersection.h"
+
+#define BIT(n)		(1U<<(n))
+
+const Phase PHASES[NUM_PHASES] = {
+	// name    lights            detectors         weight  km/h  m
+	{ "1-3",   BIT(0) | BIT(2),  BIT(0) | BIT(2),  1,      30,   10 },
+	{ "2-4",   BIT(1) | BIT(3),  BIT(1) | BIT(3),  1,      30,   10 },
+};
+
+const uint32_t PHASE_CONFLICTS[NUM_PHASES] = {
+	BIT(1),					// 1-3 crosses 2-4
+	BIT(0),					// 2-4 crosses 1-3
+};
+
+const uint32_t LIGHT_COMPATIBLE[NUM_LIGHTS] = {
+	BIT(0) | BIT(2),		// Light 1 runs with light 3
+	BIT(1) | BIT(3),		// Light 2 runs with light 4
+	BIT(0) | BIT(2),
+	BIT(1) | BIT(3),
+};
+
+const uint8_t DETECTOR_LIGHT[BUTTONS] = { 0, 1, 2, 3 };
+
+const uint8_t DETECTOR_DEBOUNCE[BUTTONS] = { DEBOUNCE_SAMPLES, DEBOUNCE_SAMPLES, DEBOUNCE_SAMPLES, DEBOUNCE_SAMPLES };
+
+static uint32_t detectorPhases[BUTTONS];		// Phases called by each detector
+static uint32_t conflictLights[NUM_PHASES];		// Lights that must be RED before a phase turns GREEN
+static Clearance clearance[NUM_PHASES];			// Change interval of each phase
+
+// Round a duration up to the display resolution of the change interval
+static uint32_t clear_round(uint32_t ms) {
+	return (ms + CLEAR_ROUND_MS - 1) / CLEAR_ROUND_MS * CLEAR_ROUND_MS;
+}
+
+/**
+ * @brief Build the lookup tables and validate the phase table.
+ *
+ * @return false if the conflict matrix is not symmetric, a phase conflicts
+ * 		   with itself, a light is shared by two conflicting phases, the
+ * 		   conflict monitor's LIGHT_COMPATIBLE forbids a phase, or a phase's
+ * 		   change interval is shorter than the monitor accepts.
+*/
+bool intersection_init(void) {
+	bool valid = true;
+
+	for (uint32_t d = 0; d < BUTTONS; d++) {
+		detectorPhases[d] = 0;
+	}
+
+	for (uint32_t p = 0; p < NUM_PHASES; p++) {
+		conflictLights[p] = 0;
+
+		for (uint32_t q = 0; q < NUM_PHASES; q++) {
+			if (!(PHASE_CONFLICTS[p] & BIT(q))) {
+				continue;
+			}
+			if (p == q || !(PHASE_CONFLICTS[q] & BIT(p)) || (PHASES[p].lights & PHASES[q].lights)) {
+				LOG("Phase %s conflict with %s is invalid", PHASES[p].name, PHASES[q].name);
+				valid = false;
+			}
+			conflictLights[p] |= PHASES[q].lights;
+		}
+		conflictLights[p] &= ~PHASES[p].lights;
+
+		for (uint32_t d = 0; d < BUTTONS; d++) {
+			if (PHASES[p].detectors & BIT(d)) {
+				detectorPhases[d] |= BIT(p);
+			}
+		}
+
+		// The conflict monitor must permit every light of the phase with every other
+		for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+			if ((PHASES[p].lights & BIT(i)) && (PHASES[p].lights & ~LIGHT_COMPATIBLE[i] & ~BIT(i))) {
+				LOG("Phase %s is not permitted by LIGHT_COMPATIBLE", PHASES[p].name);
+				valid = false;
+			}
+		}
+
+		// Stop from the approach speed, then clear the width plus a vehicle length
+		uint32_t speed = PHASES[p].speed * 2500U / 9U;		// mm/s
+		if (speed == 0) {
+			LOG("Phase %s has no approach speed", PHASES[p].name);
+			valid = false;
+			continue;
+		}
+		clearance[p].yellow = clear_round(CLEAR_REACTION_MS + speed * 1000U / (2U * CLEAR_DECEL_MM_S2));
+		clearance[p].allRed = clear_round((PHASES[p].width + CLEAR_VEHICLE_M) * 1000000U / speed);
+		if (clearance[p].yellow < MONITOR_YELLOW_MIN_MS || clearance[p].allRed < MONITOR_ALL_RED_MS) {
+			LOG("Phase %s change interval is below the conflict monitor minimum", PHASES[p].name);
+			valid = false;
+		}
+		LOG("Phase %s yellow %lu ms, all-red %lu ms", PHASES[p].name, clearance[p].yellow, clearance[p].allRed);
+	}
+
+	return valid;
+}
+
+/** @brief Bitmask of the phases called by `detector` */
+uint32_t intersection_detector_phases(uint32_t detector) {
+	return detectorPhases[detector];
+}
+
+/** @brief Bitmask of the lights that conflict with `phase` */
+uint32_t intersection_conflict_lights(uint32_t phase) {
+	return conflictLights[phase];
+}
+
+/**
+ * @brief Change interval for stopping a set of lights.
+ *
+ * The longest YELLOW and all-red of the phases the lights belong to, so
+ * every stopped movement gets its own clearance.
+ *
+ * @param lights Bitmask of Light[] indices being stopped
+*/
+Clearance intersection_clearance(uint32_t lights) {
+	Clearance c = { 0, 0 };
+
+	for (uint32_t p = 0; p < NUM_PHASES; p++) {
+		if (PHASES[p].lights & lights) {
+			if (clearance[p].yellow > c.yellow) {
+				c.yellow = clearance[p].yellow;
+			}
+			if (clearance[p].allRed > c.allRed) {
+				c.allRed = clearance[p].allRed;
+			}
+		}
+	}
+	return c;
+}
@@ -0,0 +1,215 @@
+/**
+ * @file latency.c
+ * @brief Loopback edge generator and latency histograms for the test mode.
+ *
+ * The driver runs from the main loop (latency_poll()), so the idle check
+ * reads controller state from its own context and the injected edge meets
+ * the EXTI path exactly as a real detector would. The edge time is taken
+ * just before the spare output is pulled low.
+ *
+ * Each channel is recorded from one context only (EXTI handler, main loop,
+ * TIM2 handler), so the histograms need no locking.
+*/
+
+#ifdef LATENCY_TEST
+
+#include <stdio.h>
+#include "uart.h"
+#include "lights.h"
+#include "latency.h"
+#include "systick.h"
+#include "controller.h"
+#include "intersection.h"
+
+#define LOOP_PIN(lane)			(LATENCY_LOOP_SHIFT + (lane))
+
+_Static_assert(LATENCY_LANES <= BUTTONS, "Every looped-back output needs a detector");
+_Static_assert(LATENCY_LOOP_SHIFT + LATENCY_LANES <= BUTTON_SHIFT, "Loopback outputs overlap the detector inputs");
+
+/** @brief Histogram bin width per channel (µs) */
+static const uint32_t binWidth[LAT_CHANNELS] = { 1, 1000, 2 };
+static const uint32_t limit[LAT_CHANNELS] = { LATENCY_LIMIT_EXTI_US, LATENCY_LIMIT_RESPONSE_US, LATENCY_LIMIT_TIMER_US };
+static const char *const channelName[LAT_CHANNELS] = { "exti", "response", "timer" };
+
+static LatencyStats stats[LAT_CHANNELS];
+
+static enum { WAITING, INJECTED } phase = WAITING;
+static uint32_t lane = 0;					// Detector of the current edge
+static uint64_t edgeTime;					// Time the spare output was pulled low (µs)
+static volatile bool edgeSeen;				// EXTI entry recorded for the current edge
+static bool responded;						// Light response recorded for the current edge
+static uint32_t runs = 0;
+static uint32_t timeouts = 0;
+static uint32_t jitter = 1;					// LCG state varying the edge phase against the timers
+
+static volatile bool due = false;
+static void driverTimerExpired(void);
+static SoftTimer driverTimer = { .callback = driverTimerExpired };
+
+static void driverTimerExpired(void) {
+	due = true;
+}
+
+/**
+ * @brief Configure the spare outputs and schedule the first edge.
+ *
+ * Call after exti_init() and systick_init(). The outputs are open drain,
+ * so they idle released and only ever pull the detector line low, in
+ * parallel with the detector itself.
+*/
+void latency_init(void) {
+	for (uint32_t l = 0; l < LATENCY_LANES; l++) {
+		uint32_t pin = LOOP_PIN(l);
+		GPIOC->BSRR = (1U << pin);				// Released before it becomes an output
+		GPIOC->OTYPER |= (1U << pin);			// Open drain
+		GPIOC->MODER &= ~(3U << (pin * 2));
+		GPIOC->MODER |= (1U << (pin * 2));		// General purpose output
+	}
+	systick_timer_start(&driverTimer, LATENCY_PERIOD_MS);
+}
+
+/** @brief Add one sample to a channel */
+void latency_record(LatencyChannel channel, uint32_t us) {
+	LatencyStats *s = &stats[channel];
+	uint32_t bin = us / binWidth[channel];
+
+	if (bin >= LATENCY_HIST_BINS) {
+		bin = LATENCY_HIST_BINS - 1;
+	}
+	s->hist[bin]++;
+	s->count++;
+	if (us > s->max) {
+		s->max = us;
+	}
+}
+
+/** @brief EXTI entry - `now` is the time latched by the handler */
+void latency_exti(uint64_t now) {
+	if (phase == INJECTED && !edgeSeen) {
+		edgeSeen = true;
+		latency_record(LAT_EXTI, (uint32_t)(now - edgeTime));
+	}
+}
+
+/** @brief Light outputs written - `lit` are the lights shown other than RED, the first after an edge is its response */
+void latency_lights(uint32_t lit) {
+	if (phase == INJECTED && !responded && lit) {
+		responded = true;
+		latency_record(LAT_RESPONSE, (uint32_t)(systickGetMicros() - edgeTime));
+		due = true;								// Release the detector on the next poll
+	}
+}
+
+/**
+ * @brief Upper bound of the sample at `permille` / 1000 of a channel (µs).
+ *
+ * Resolved to the channel's bin width; samples in the saturating last bin
+ * report the maximum.
+*/
+uint32_t latency_percentile(LatencyChannel channel, uint32_t permille) {
+	const LatencyStats *s = &stats[channel];
+	if (s->count == 0) {
+		return 0;
+	}
+
+	uint32_t rank = (uint32_t)(((uint64_t)s->count * permille + 999U) / 1000U);
+	uint32_t seen = 0;
+	for (uint32_t b = 0; b < LATENCY_HIST_BINS - 1; b++) {
+		seen += s->hist[b];
+		if (seen >= rank) {
+			uint32_t upper = (b + 1) * binWidth[channel] - 1;
+			return upper < s->max ? upper : s->max;
+		}
+	}
+	return s->max;
+}
+
+const LatencyStats *latency_stats(LatencyChannel channel) {
+	return &stats[channel];
+}
+
+uint32_t latency_limit(LatencyChannel channel) {
+	return limit[channel];
+}
+
+/** @brief Edges that got no light response within LATENCY_TIMEOUT_MS */
+uint32_t latency_timeouts(void) {
+	return timeouts;
+}
+
+/**
+ * @brief Log every channel against its limit.
+ *
+ * @return true if every channel's p99 is within its limit and every edge
+ * 		   got a response
+*/
+bool latency_report(void) {
+	bool pass = (timeouts == 0);
+
+	for (uint32_t c = 0; c < LAT_CHANNELS; c++) {
+		uint32_t p99 = latency_percentile(c, 990);
+		bool ok = (p99 <= limit[c]);
+		pass = pass && ok;
+		LOG("lat %s n=%lu p50=%lu p99=%lu max=%lu", channelName[c], stats[c].count,
+				latency_percentile(c, 500), p99, stats[c].max);
+		LOG("lat %s limit=%lu %s", channelName[c], limit[c], ok ? "PASS" : "FAIL");		// LOG_MAX_ARGS per record
+	}
+	LOG("lat edges=%lu timeouts=%lu %s", runs, timeouts, pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+// Looped-back lane whose light is RED with its detector clear, or -1. With no phase running
+// or waiting and the debounce filter waiting for an edge, an edge on it interrupts and is
+// answered straight away by the light changes of a new phase.
+static int32_t readyLane(void) {
+	if (!controller_idle() || debounce_busy()) {
+		return -1;
+	}
+	for (uint32_t l = 0; l < LATENCY_LANES; l++) {
+		if (Light[DETECTOR_LIGHT[l]].state == RED && !(debounce_state() & (1U << l)) &&
+				(GPIOC->IDR & (1U << (BUTTON_SHIFT + l)))) {
+			return (int32_t)l;
+		}
+	}
+	return -1;
+}
+
+/** @brief Advance the edge generator - called from the main loop after the events */
+void latency_poll(void) {
+	if (!due) {
+		return;
+	}
+	due = false;
+
+	if (phase == WAITING) {
+		int32_t next = readyLane();
+		if (next < 0) {
+			systick_timer_start(&driverTimer, LATENCY_RETRY_MS);
+			return;
+		}
+		lane = (uint32_t)next;
+		edgeSeen = false;
+		responded = false;
+		phase = INJECTED;
+		edgeTime = systickGetMicros();
+		GPIOC->BSRR = (1U << (LOOP_PIN(lane) + 16));	// Pull the detector low
+		systick_timer_start(&driverTimer, LATENCY_TIMEOUT_MS);
+		return;
+	}
+
+	// Release once the controller has answered, or give up on the edge
+	if (!responded) {
+		timeouts++;
+	}
+	GPIOC->BSRR = (1U << LOOP_PIN(lane));
+	phase = WAITING;
+	runs++;
+	if (runs % LATENCY_REPORT_RUNS == 0) {
+		latency_report();
+	}
+
+	jitter = jitter * 1103515245U + 12345U;
+	systick_timer_start(&driverTimer, LATENCY_PERIOD_MS + ((jitter >> 16) % 16U));
+}
+
+#endif /* LATENCY_TEST */
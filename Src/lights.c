@@ -7,7 +7,8 @@
  * It:
  * 	- Manages traffic light states
  * 	- Handles state transitions
- * 	- Updates LED outputs using atomic GPIO operations
+ * 	- Updates LED outputs using atomic GPIO operations - one BSRR store
+ * 	  per transition for all heads involved
  * 
  * The module operates on a global array of `TrafficLight` structures, where
  * each element represents one traffic light at the intersection.
@@ -19,169 +20,209 @@
 
 #include "uart.h"
 #include "lights.h"
+#include "latency.h"
+#include "monitor.h"
+#include "profile.h"
 #include "systick.h"
+#include "intersection.h"
 /**
  * @brief Array of Traffic light structures.
  * 
- * @note The array size is defined by NUM_LIGHTS (4 in this case)
+ * @note The array size is defined by NUM_LIGHTS (the heads listed in pinmap.h)
 */
-TrafficLight Light[NUM_LIGHTS];			// Instantiate 4 traffic light
+TrafficLight Light[NUM_LIGHTS];			// One per signal head of the pin map
 
 /**
- * @brief Initialize and map traffic light configuration
+ * @brief Initialize the traffic light states.
  * 
- * Populates the global 'Light' array with initial traffic light states,
- * car counts, and GPIO pin mappings. 
- * Each traffic light is assigned its corresponding RED and GREEN GPIO pins
- * and an initial state based on expected traffic flow.
+ * Clears the runtime state of every light in the global 'Light' array.
+ * The GPIO pins of each light come from the pin map (pinmap.h) and are
+ * resolved at compile time in LIGHT_BSRR.
  * 
- * High-traffic directions are initialized to GREEM, while low-traffic 
- * directions start at RED.
+ * Lights of the initial phase (INITIAL_PHASE, the high-traffic direction)
+ * start GREEN, all others start at RED.
 */
 void map_lights(void) 
 {
-	// fields: state, carCount, redPin, greenPin. 
-	Light[0] = (TrafficLight){GREEN, 0, PIN_LIGHT1_RED, PIN_LIGHT1_GREEN};		// High traffic - start with GREEN
-	Light[1] = (TrafficLight){RED,   0, PIN_LIGHT2_RED, PIN_LIGHT2_GREEN};		// Low traffic - start with RED
-	Light[2] = (TrafficLight){GREEN, 0, PIN_LIGHT3_RED, PIN_LIGHT3_GREEN};		// High traffic - start with GREEN
-	Light[3] = (TrafficLight){RED,   0, PIN_LIGHT4_RED, PIN_LIGHT4_GREEN};		// Low traffic - start with RED
+	for (int i=0; i<NUM_LIGHTS; i++) {
+		Light[i] = (TrafficLight){ .state = (PHASES[INITIAL_PHASE].lights & (1U<<i)) ? GREEN : RED };
+	}
 }
 
-// Update the appropriate LED through the GPIO output based on state
 /**
- * @brief Update traffic light LEDs based on the current light state.
- * 
- * Sets or resets the RED and GREEN GPIO outputs for a single traffic
- * light using the GPIOB BSRR register. 
- * The LED behavior is determined by the `state` field of the provided 
- * TrafficLight structure. 
+ * @brief GPIOB BSRR word that shows each state on each light.
  *
- * @param light Pointer to a TrafficLight structure containing the current
- * 				state and GPIO pin mappings
+ * Outputs are active low: BR (bit + 16) turns a LED on, BS (bit) turns it
+ * off. YELLOW lights RED and GREEN together.
 */
-void lights_update(const TrafficLight *light) 
+#define HEAD_BSRR(red, green) {										\
+	[RED]    = (1U << ((red) + 16)) | (1U << (green)),				\
+	[YELLOW] = (1U << ((red) + 16)) | (1U << ((green) + 16)),		\
+	[GREEN]  = (1U << ((green) + 16)) | (1U << (red)),				\
+	[OFF]    = (1U << (red)) | (1U << (green)),						\
+}
+
+#define HEAD_ENTRY(red, green)	HEAD_BSRR(red, green),
+
+static const uint32_t LIGHT_BSRR[NUM_LIGHTS][OFF + 1] = {
+	PINMAP_LIGHTS(HEAD_ENTRY)
+};
+
+/**
+ * @brief Drive the LEDs of a set of lights from their current states.
+ *
+ * The set/reset bits of every light in `lights` are combined from
+ * LIGHT_BSRR and written with a single GPIOB BSRR store, so all heads of
+ * a transition change on the same bus cycle. The word is validated by
+ * the conflict monitor first and dropped if it is rejected.
+ *
+ * @param lights Bitmask of traffic light indices (bit n = Light[n])
+*/
+void lights_commit(uint32_t lights)
 {
-	switch (light->state) {
-		case RED:
-			GPIOB->BSRR = (1U << (light->redPin + 16));  	// RED LED ON
-			GPIOB->BSRR = (1U << light->greenPin);			// GREEN LED OFF
-			break;
-		case YELLOW:
-			// Turn ON both RED and GREEN to get YELLOW 
-			GPIOB->BSRR = ((1U << (light->redPin + 16)) | (1U <<(light->greenPin + 16)));
-			break;
-		case GREEN:
-			GPIOB->BSRR = (1U << (light->greenPin + 16));   // GREEN LED ON
-			GPIOB->BSRR = (1U << light->redPin);			// RED LED OFF
-			break;
-		case OFF:
-			// Turn off both RED and GREEN to turn Light off
-			GPIOB->BSRR = ((1U << light->redPin) | (1U << light->greenPin));
-			break;
+	PROFILE_BEGIN(PROF_LIGHTS_COMMIT);
+	uint32_t bsrr = 0;
+	uint32_t lit = 0;			// Lights showing anything but RED
+
+	for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+		if (lights & (1U << i)) {
+			bsrr |= LIGHT_BSRR[i][Light[i].state];
+			if (Light[i].state != RED) {
+				lit |= (1U << i);
+			}
+		}
+	}
+	if (bsrr && monitor_check(bsrr)) {		// Every write passes the conflict monitor
+		GPIOB->BSRR = bsrr;
+	}
+	LATENCY_LIGHTS(lit);
+	PROFILE_END(PROF_LIGHTS_COMMIT);
+}
+
+// Move the lights in `lights` from RED to GREEN - logical state only
+static void to_green(uint32_t lights) {
+	for (int i=0; i<NUM_LIGHTS; i++) {
+		if (!(lights & (1U<<i))) {
+			continue;
+		}
+		if (Light[i].state == RED) {
+			// Transition directly from RED to GREEN
+			Light[i].state = GREEN;
+			LOG("Light %d turned GREEN", i + 1);
+		} else {
+			// Light already GREEN - Nothing to do
+			LOG("Light %d is already GREEN", i + 1);
+		}
+	}
+}
+
+// Move the lights in `lights` from YELLOW to RED - logical state only
+static void to_red(uint32_t lights) {
+	for (int i=0; i<NUM_LIGHTS; i++) {
+		if ((lights & (1U<<i)) && Light[i].state == YELLOW) {
+			// Transition from YELLOW to RED
+			Light[i].state = RED;
+			LOG("Light %d turned RED", i + 1);
+		}
 	}
 }
 
 /**
- * @brief Transition a pair of traffic lights to GREEN.
+ * @brief Transition a set of traffic lights to GREEN.
  * 
- * Transitions the specified pair of traffic lights to GREEN state if 
- * currently RED. If GREEN, no state change is performed.
+ * Transitions every light in `lights` to GREEN state if currently RED.
+ * If GREEN, no state change is performed.
  * 
  * After updating the logical state, the corresponding GPIO outputs are 
- * updated via `lights_update()`.
+ * updated via `lights_commit()`.
  * 
- * @param lightNum1 Index of the first traffic light in the pair
- * @param lightNum2 Index of the second traffic light in the pair
+ * @param lights Bitmask of traffic light indices (bit n = Light[n])
 */
-void lights_set_green(int lightNum1, int lightNum2) 
+void lights_set_green(uint32_t lights) 
 {
-	// Check if the light pair is RED
-	if (Light[lightNum1].state == RED || Light[lightNum2].state == RED) {
-		// Transition directly from RED to GREEN
-		Light[lightNum1].state = GREEN;
-		Light[lightNum2].state = GREEN;
-		LOG("Light %d turned GREEN", lightNum1 + 1);
-		LOG("Light %d turned GREEN", lightNum2 + 1);
-	} else {
-		// Light already GREEN - Nothing to do
-		LOG("Light %d is already GREEN", lightNum1 + 1);
-		LOG("Light %d is already GREEN", lightNum2 + 1);
-	}
-	// Update the Light states
-	lights_update(&Light[lightNum1]);
-	lights_update(&Light[lightNum2]);
+	to_green(lights);
+	lights_commit(lights);
 }
 
 /**
- * @brief Transition a pair of traffic lights from GREEN to YELLOW
+ * @brief Transition a set of traffic lights from GREEN to YELLOW
  * 
- * If light in the specified pair is currently GREEN, they are transitioned 
- * to YELLOW state. If RED, no state change is performed.
+ * Lights in `lights` that are currently GREEN are transitioned to YELLOW
+ * state. If RED, no state change is performed.
  * 
  * After updating the logical state, the corresponding GPIO outputs are 
- * updated via `lights_update()`.
+ * updated via `lights_commit()`.
  * 
- * @param lightNum1 Index of the first traffic light in the pair
- * @param lightNum2 Index of the second traffic light in the pair
+ * @param lights Bitmask of traffic light indices (bit n = Light[n])
  * 
- * @return 
+ * @return Bitmask of the lights in `lights` now YELLOW - 0 if all of them
+ * 		   were already RED
 */
-uint32_t lights_set_yellow(int lightNum1, int lightNum2) 
+uint32_t lights_set_yellow(uint32_t lights) 
 {
-	if (Light[lightNum1].state == GREEN || Light[lightNum2].state == GREEN) {
-		// Transition from GREEN to YELLOW
-		Light[lightNum1].state = YELLOW;
-		Light[lightNum2].state = YELLOW;
-		LOG("Light %d turned YELLOW", lightNum1 + 1);
-		LOG("Light %d turned YELLOW", lightNum2 + 1);
-	} else {
-		// Light already RED - Nothing to do
-		LOG("Light %d is already RED", lightNum1 + 1);
-		LOG("Light %d is already RED", lightNum2 + 1);
-	}
+	uint32_t stopping = 0;
 
-	// Update the Light states
-	lights_update(&Light[lightNum1]);
-	lights_update(&Light[lightNum2]);
+	for (int i=0; i<NUM_LIGHTS; i++) {
+		if (!(lights & (1U<<i))) {
+			continue;
+		}
+		if (Light[i].state == GREEN) {
+			// Transition from GREEN to YELLOW
+			Light[i].state = YELLOW;
+			LOG("Light %d turned YELLOW", i + 1);
+		} else if (Light[i].state == RED) {
+			// Light already RED - Nothing to do
+			LOG("Light %d is already RED", i + 1);
+		}
+		if (Light[i].state == YELLOW) {
+			stopping |= (1U<<i);
+		}
+	}
+	lights_commit(lights);
 
-	return 1;
+	return stopping;
 }
 
 /**
- * @brief Transition a pair of traffic lights from YELLOW to RED
+ * @brief Transition a set of traffic lights from YELLOW to RED
  * 
- * If light in the specified pair is currently YELLOW, they are transitioned 
- * to RED state.
+ * Lights in `lights` that are currently YELLOW are transitioned to RED
+ * state.
  * 
  * After updating the logical state, the corresponding GPIO outputs are 
- * updated via `lights_update()`.
+ * updated via `lights_commit()`.
  * 
- * @param lightNum1 Index of the first traffic light in the pair
- * @param lightNum2 Index of the second traffic light in the pair
+ * @param lights Bitmask of traffic light indices (bit n = Light[n])
  * 
- * @return 
+ * @return 1 once the lights are RED
 */
-uint32_t lights_set_red(int lightNum1, int lightNum2) {
-	// Check if the Light pair is YELLOW
-	if (Light[lightNum1].state == YELLOW || Light[lightNum2].state == YELLOW) {
-		// Transition from YELLOW to RED
-		Light[lightNum1].state = RED;
-		Light[lightNum2].state = RED;
-		LOG("Light %d turned RED", lightNum1 + 1);
-		LOG("Light %d turned RED", lightNum2 + 1);
-	} 
-
-	// Update the Light states
-	lights_update(&Light[lightNum1]);
-	lights_update(&Light[lightNum2]);
+uint32_t lights_set_red(uint32_t lights) {
+	to_red(lights);
+	lights_commit(lights);
 
 	return 1;
 }
 
+/**
+ * @brief Stop one set of lights and release another in one output write.
+ *
+ * Lights in `stop` go from YELLOW to RED and lights in `go` from RED to
+ * GREEN; both sets reach the outputs with a single `lights_commit()`, so
+ * no head shows GREEN while a conflicting one is still YELLOW.
+ *
+ * @param stop Bitmask of the lights to turn RED
+ * @param go   Bitmask of the lights to turn GREEN
+*/
+void lights_set_phase(uint32_t stop, uint32_t go) {
+	to_red(stop);
+	to_green(go);
+	lights_commit(stop | go);
+}
+
 /** @brief Set all traffic lights to their initial states */
 void lights_set_initial_state(void) {
+	lights_commit((1U << NUM_LIGHTS) - 1U);
 	for (int i=0; i<NUM_LIGHTS; i++) {
-		lights_update(&Light[i]);
 		LOG("Light %d is %s", i + 1, (Light[i].state == GREEN) ? "GREEN" : "RED");
 	}
 }
@@ -190,39 +231,15 @@ void lights_set_initial_state(void) {
  * @brief Initializes GPIO output pins
  * 
  * This function enables the required GPIO peripheral clocks and configures 
- * the GPIO pins connected to the traffic light LEDs as digital outputs.
+ * every signal head pin of the pin map as a digital output, with a single
+ * MODER write computed at compile time.
  * 
  * @note Pins are configured in push-pull output mode with default speed 
  * 		 and no internal pull-up or pull-down resistors.
 */
 void lights_init(void) {
-	RCC->AHB1ENR |= (1U<<0);		// Enable clock GPIOA
-	RCC->AHB1ENR |= (1U<<1);		// Enable clock GPIOB
-	RCC->AHB1ENR |= (1U<<2);		// Enable clock GPIOC
-
-	// Light 1
-	GPIOB->MODER |= (1U<<20);		// PB10 output mode - R
-	GPIOB->MODER &= ~(1U<<21);
-	GPIOB->MODER |= (1U<<8);		// PB4 output mode - G
-	GPIOB->MODER &= ~(1U<<9);
-
-	// Light 2
-	GPIOB->MODER |= (1U<<10);		// PB5 output mode - R
-	GPIOB->MODER &= ~(1U<<11);
-	GPIOB->MODER |= (1U<<6);		// PB3 output mode - G
-	GPIOB->MODER &= ~(1U<<7);
-
-	// Light 3
-	GPIOB->MODER |= (1U<<4);		// PB2 output mode - R
-	GPIOB->MODER &= ~(1U<<5);
-	GPIOB->MODER |= (1U<<2);		// PB1 output mode - G
-	GPIOB->MODER &= ~(1U<<3);
-
-	// Light 4
-	GPIOB->MODER |= (1U<<28);		// PB14 output mode - R
-	GPIOB->MODER &= ~(1U<<29);
-	GPIOB->MODER |= (1U<<26);		// PB13 output mode - G
-	GPIOB->MODER &= ~(1U<<27);
-}
+	RCC->AHB1ENR |= (1U<<0) | (1U<<1) | (1U<<2);		// Enable clock GPIOA, GPIOB, GPIOC
 
-	
\ No newline at end of file
+	GPIOB->MODER = (GPIOB->MODER & ~PINMAP_FIELD2(PINMAP_LIGHT_PINS, 3U))
+			| PINMAP_FIELD2(PINMAP_LIGHT_PINS, GPIO_MODE_OUTPUT);
+}
@@ -11,10 +11,19 @@
 #include "stm32f446xx.h"
 
 #include "uart.h"
+#include "config.h"
+#include "console.h"
 #include "exti.h"
-#include "queue.h"
+#include "event.h"
 #include "lights.h"
+#include "latency.h"
+#include "stats.h"
+#include "monitor.h"
+#include "profile.h"
+#include "debounce.h"
 #include "systick.h"
+#include "controller.h"
+#include "intersection.h"
 
 /**
  * @brief Initializes all core system peripherals.
@@ -27,15 +36,33 @@
  * 	- GPIO configuration for traffic lights
  * 	- External interrupt configuration (EXTI)
  * 	- UART2 initialization for logging output
- * 	- SysTick timer Initialization
+ * 	- System time base and software timer initialization (TIM2)
+ * 	- Runtime parameters from the flash config store
+ * 	- Detector debounce filter
  * 	- Logical mapping of traffic light instances
+ * 	- Phase table lookups and validation
+ * 	- Conflict monitor
+ *
+ * A phase table that fails validation stops the controller and leaves the
+ * heads in the monitor's all-red flash.
 */
 static void system_init(void) {
+	PROFILE_INIT();					// Start the cycle counter (PROFILE builds only)
 	lights_init();					// Initialize light GPIO registers
 	exti_init();					// Initialize the input interrupts
 	uart2_init();					// Initialize UART
-	systick_init();					// Initialize SysTick
+	systick_init();					// Initialize time base and timers
+	config_init();					// Load the runtime parameters from flash
+	debounce_init();				// Load per-lane debounce settings
+	LATENCY_INIT();					// Loopback edge generator (LATENCY_TEST builds only)
 	map_lights();					// Map the lights
+	bool phasesValid = intersection_init();		// Build the phase lookup tables
+	monitor_init();					// Conflict monitor tables - before the first output write
+	if (!phasesValid) {
+		LOG("Phase table is inconsistent - check PHASE_CONFLICTS");
+		controller_stop();
+		monitor_fail_safe(MONITOR_PHASE_TABLE);
+	}
 }
 
 /**
@@ -44,8 +71,11 @@ static void system_init(void) {
  * This function initializes the system, sets the initial traffic light 
  * states, and enters an infinite low-power loop.
  * 
- * All runtime behavior is interrupt-driven. Application control flow 
- * transitions to the external interrupt handler @ref EXTI15_10_IRQHandler().
+ * Interrupt handlers (@ref EXTI15_10_IRQHandler() and the detector
+ * debounce filter, TIM2 timer callbacks) only capture timestamped events. The loop sleeps until an interrupt
+ * arrives and then runs the control logic for the captured events with
+ * @ref controller_process_events(). Received console bytes also keep the
+ * loop awake until @ref console_poll() has consumed them.
  */
 int main() {
 	
@@ -58,6 +88,19 @@ int main() {
 	lights_set_initial_state();
 	
 	while(1) {
-		__WFI();  // Wait for interrupt (low power mode)
+		// Sleep only if no event or console input is pending. Interrupts stay masked
+		// between the check and WFI so an event raised in between still wakes the core.
+		__disable_irq();
+		if (!event_pending() && !uart2_rx_pending()) {
+			__WFI();  // Wait for interrupt (low power mode)
+		}
+		__enable_irq();
+
+		controller_process_events();	// Run the control logic for captured events
+		console_poll();					// Run the next received command line
+		config_poll();					// Write a pending parameter save to flash
+		stats_poll();					// Queue the next statistics export frames
+		PROFILE_POLL();					// Dump cycle statistics when requested
+		LATENCY_POLL();					// Drive the next latency test edge
 	}
 }
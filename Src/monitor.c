@@ -0,0 +1,176 @@
+/**
+ * @file monitor.c
+ * @brief Conflict monitor for the signal head outputs.
+ *
+ * The monitor keeps its own image of the light outputs and decodes each
+ * head from its RED/GREEN pins, so a fault anywhere between the phase
+ * logic and the BSRR word is caught. Each head has a conflict mask built
+ * once from LIGHT_COMPATIBLE, and every lit head's mask must miss the lit
+ * set - one AND per lit head, for any number of heads a mask can hold.
+ * Transitions are checked per head against the time it entered its
+ * current indication.
+ *
+ * @note monitor_check() runs in the main loop (lights_commit()); the fault
+ * 		 flash runs from the TIM2 timer callback once the main loop has
+ * 		 been locked out.
+*/
+
+#include <stdio.h>
+#include "uart.h"
+#include "lights.h"
+#include "pinmap.h"
+#include "monitor.h"
+#include "systick.h"
+#include "intersection.h"
+
+#define RED_BIT(red, green)			(1U << (red)),
+#define GREEN_BIT(red, green)		(1U << (green)),
+#define RED_PIN(red, green)			| (1U << (red))
+#define GREEN_PIN(red, green)		| (1U << (green))
+
+#define RED_PINS		(0U PINMAP_LIGHTS(RED_PIN))
+#define GREEN_PINS		(0U PINMAP_LIGHTS(GREEN_PIN))
+#define ALL_RED			((RED_PINS << 16) | GREEN_PINS)		// BSRR: RED on, GREEN off (active low)
+#define ALL_DARK		(RED_PINS | GREEN_PINS)
+
+_Static_assert(NUM_LIGHTS <= 16, "Conflict masks are 16 bits");
+
+static const uint32_t redBit[NUM_LIGHTS] = { PINMAP_LIGHTS(RED_BIT) };
+static const uint32_t greenBit[NUM_LIGHTS] = { PINMAP_LIGHTS(GREEN_BIT) };
+
+static uint16_t conflicts[NUM_LIGHTS];		// Lights that may not be lit with each light
+
+static uint32_t image;						// Light pins as last written (ODR bits)
+static LightState shown[NUM_LIGHTS];		// Indication of each head
+static uint64_t shownSince[NUM_LIGHTS];		// Time each head entered its indication (µs)
+static bool started = false;				// First write seen - before it the outputs are unknown
+
+static MonitorStatus status = { MONITOR_OK, 0, 0 };
+
+static void flashTimerExpired(void);
+static SoftTimer flashTimer = { .callback = flashTimerExpired };
+static bool flashOn = false;
+
+static const char *const faultName[] = { "none", "conflict", "sequence", "short yellow", "short all-red", "phase table" };
+
+/**
+ * @brief Build the per-light conflict masks from LIGHT_COMPATIBLE.
+ *
+ * Call after map_lights(), before the first light output is written.
+*/
+void monitor_init(void) {
+	for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+		conflicts[i] = (uint16_t)(((1U << NUM_LIGHTS) - 1U) & ~LIGHT_COMPATIBLE[i] & ~(1U << i));
+	}
+}
+
+// Indication of light `i` in an output image (LEDs are active low, both on is YELLOW)
+static LightState decode(uint32_t odr, uint32_t i) {
+	bool red = !(odr & redBit[i]);
+	bool green = !(odr & greenBit[i]);
+	return (red && green) ? YELLOW : red ? RED : green ? GREEN : OFF;
+}
+
+// Latch the fault, take the heads to RED and start flashing
+static bool trip(MonitorFault fault, uint32_t light, uint64_t now) {
+	status = (MonitorStatus){ fault, light, now };
+	GPIOB->BSRR = ALL_RED;
+	flashOn = true;
+	systick_timer_start(&flashTimer, MONITOR_FLASH_MS);
+	LOG("MONITOR FAULT: %s at light %lu - all-red flash", faultName[fault], light + 1);
+	return false;
+}
+
+static void flashTimerExpired(void) {
+	flashOn = !flashOn;
+	GPIOB->BSRR = flashOn ? ALL_RED : ALL_DARK;
+	systick_timer_start(&flashTimer, MONITOR_FLASH_MS);
+}
+
+/**
+ * @brief Validate a light output write before it is stored.
+ *
+ * @param bsrr GPIOB BSRR word about to be written
+ * @return true if the write may go ahead; false once the monitor has
+ * 		   latched a fault - the caller must drop the write
+*/
+bool monitor_check(uint32_t bsrr) {
+	if (status.fault != MONITOR_OK) {
+		return false;
+	}
+
+	uint64_t now = systickGetMicros();
+	uint32_t next = (image & ~(bsrr >> 16)) | (bsrr & 0xFFFFU);		// BS wins over BR
+	LightState state[NUM_LIGHTS];
+	uint32_t lit = 0;
+
+	for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+		state[i] = decode(next, i);
+		if (state[i] != RED) {
+			lit |= (1U << i);
+		}
+	}
+	for (uint32_t l = lit; l; l &= l - 1U) {
+		uint32_t i = (uint32_t)__builtin_ctz(l);
+		if (lit & conflicts[i]) {
+			return trip(MONITOR_CONFLICT, i, now);
+		}
+	}
+
+	for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+		LightState from = shown[i];
+		LightState to = state[i];
+		if (to == OFF) {
+			return trip(MONITOR_SEQUENCE, i, now);			// Dark head outside the fault flash
+		}
+		if (!started || to == from) {
+			continue;
+		}
+		if (to == YELLOW ? from != GREEN : to == RED ? from != YELLOW : from != RED) {
+			return trip(MONITOR_SEQUENCE, i, now);
+		}
+		if (to == RED && now - shownSince[i] < MONITOR_YELLOW_MIN_MS * 1000ULL) {
+			return trip(MONITOR_YELLOW_SHORT, i, now);
+		}
+		if (to == GREEN) {
+			// Conflicting heads are RED in `state` (checked above) - a head turning RED in this write has cleared for 0 ms
+			for (uint32_t c = conflicts[i]; c; c &= c - 1U) {
+				uint32_t j = (uint32_t)__builtin_ctz(c);
+				uint64_t cleared = (shown[j] == RED) ? now - shownSince[j] : 0;
+				if (cleared < MONITOR_ALL_RED_MS * 1000ULL) {
+					return trip(MONITOR_ALL_RED_SHORT, i, now);
+				}
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+		if (!started || state[i] != shown[i]) {
+			shown[i] = state[i];
+			shownSince[i] = now;
+		}
+	}
+	image = next;
+	started = true;
+	return true;
+}
+
+/**
+ * @brief Latch `fault` and flash all heads RED without a rejected write.
+ *
+ * For faults found outside monitor_check(); the fault record names light 1.
+*/
+void monitor_fail_safe(MonitorFault fault) {
+	if (status.fault == MONITOR_OK) {
+		trip(fault, 0, systickGetMicros());
+	}
+}
+
+/** @brief Current fault record - `fault` is MONITOR_OK while running normally */
+const MonitorStatus *monitor_status(void) {
+	return &status;
+}
+
+const char *monitor_fault_name(MonitorFault fault) {
+	return faultName[fault];
+}
@@ -0,0 +1,169 @@
+/**
+ * @file policy.c
+ * @brief Phase selection policies.
+ *
+ * 	- FIFO: serves phases in the order they were called (the original
+ * 	  behaviour). Calls are kept in a ring; the entry of a phase served out
+ * 	  of order is marked stale and skipped when it reaches the front.
+ * 	- LQF: longest queue first - the phase whose most loaded light has the
+ * 	  most vehicles counted since its last GREEN.
+ * 	- Max-pressure: the phase releasing the largest total queue. Without
+ * 	  downstream detectors the outflow term of the pressure is zero, so the
+ * 	  pressure of a phase is the sum of its lights' queues.
+ * 	- WFQ: stride scheduling - each service advances a phase's pass by
+ * 	  WFQ_STRIDE / weight and the lowest pass wins, so over time phases
+ * 	  are served in proportion to Phase.weight.
+ *
+ * Every decision scans the waiting phases once and their lights, so its
+ * cost depends only on the table size, never on traffic volume.
+*/
+
+#include <stddef.h>
+
+#include "ring.h"
+#include "lights.h"
+#include "policy.h"
+#include "intersection.h"
+
+#define WFQ_STRIDE		(1U<<16)
+
+/** @brief Lowest waiting phase index, used to break ties */
+static uint32_t first_phase(uint32_t waiting) {
+	return (uint32_t)__builtin_ctz(waiting);
+}
+
+#if PHASE_POLICY == PHASE_POLICY_FIFO
+
+RING_SPSC_DEFINE(CallQueue, call_queue, uint8_t, 32)
+_Static_assert(NUM_PHASES <= 32, "FIFO call queue holds at most 32 phases");
+
+static CallQueue calls;
+static uint8_t stale[NUM_PHASES];				// Entries left behind by phases served out of order
+
+// Drop stale entries from the front - a phase's stale entries are older than its live one
+static const uint8_t *fifo_front(void) {
+	const uint8_t *entry;
+	while ((entry = call_queue_peek(&calls)) != NULL && stale[*entry] > 0) {
+		uint8_t dropped;
+		stale[*entry]--;
+		call_queue_pop(&calls, &dropped);
+	}
+	return entry;
+}
+
+static void fifo_enqueue(uint32_t phase, uint32_t now) {
+	uint8_t entry = (uint8_t)phase;
+	(void)now;
+	fifo_front();
+	call_queue_push(&calls, &entry);			// At most one live entry per waiting phase
+}
+
+static uint32_t fifo_select(uint32_t waiting, uint32_t now) {
+	const uint8_t *entry = fifo_front();
+	(void)now;
+	return (entry != NULL && (waiting & (1U << *entry))) ? *entry : first_phase(waiting);
+}
+
+static void fifo_served(uint32_t phase, uint32_t now) {
+	const uint8_t *entry = fifo_front();
+	uint8_t served;
+	(void)now;
+	if (entry != NULL && *entry == phase) {
+		call_queue_pop(&calls, &served);
+	} else {
+		stale[phase]++;							// Forced or starved past its turn - entry still queued
+	}
+}
+
+static const PhasePolicy policy = { "fifo", fifo_enqueue, fifo_select, fifo_served };
+
+#elif PHASE_POLICY == PHASE_POLICY_LQF || PHASE_POLICY == PHASE_POLICY_PRESSURE
+
+/** @brief Vehicles waiting at the lights of a phase: longest lane and total */
+static void phase_queue(uint32_t phase, uint32_t *longest, uint32_t *total) {
+	*longest = 0;
+	*total = 0;
+	for (int i=0; i<NUM_LIGHTS; i++) {
+		if (PHASES[phase].lights & (1U<<i)) {
+			uint32_t count = (uint32_t)Light[i].carCount;
+			*total += count;
+			if (count > *longest) {
+				*longest = count;
+			}
+		}
+	}
+}
+
+// Queue lengths are read at decision time - nothing to track
+static void queue_track(uint32_t phase, uint32_t now) {
+	(void)phase;
+	(void)now;
+}
+
+static uint32_t queue_select(uint32_t waiting, uint32_t now) {
+	uint32_t best = first_phase(waiting);
+	uint32_t bestScore = 0;
+	(void)now;
+
+	for (uint32_t p=best; p<NUM_PHASES; p++) {
+		if (!(waiting & (1U << p))) {
+			continue;
+		}
+		uint32_t longest, total;
+		phase_queue(p, &longest, &total);
+		uint32_t score = (PHASE_POLICY == PHASE_POLICY_LQF) ? longest : total;
+		if (score > bestScore) {
+			best = p;
+			bestScore = score;
+		}
+	}
+	return best;
+}
+
+#if PHASE_POLICY == PHASE_POLICY_LQF
+static const PhasePolicy policy = { "lqf", queue_track, queue_select, queue_track };
+#else
+static const PhasePolicy policy = { "pressure", queue_track, queue_select, queue_track };
+#endif
+
+#elif PHASE_POLICY == PHASE_POLICY_WFQ
+
+static uint32_t pass[NUM_PHASES];
+static uint32_t globalPass = 0;					// Pass of the last phase served
+
+static void wfq_enqueue(uint32_t phase, uint32_t now) {
+	(void)now;
+	// A phase returning from idle starts at the current virtual time instead of
+	// cashing in credit for the time it had nothing to send
+	if ((int32_t)(pass[phase] - globalPass) < 0) {
+		pass[phase] = globalPass;
+	}
+}
+
+static uint32_t wfq_select(uint32_t waiting, uint32_t now) {
+	uint32_t best = first_phase(waiting);
+	(void)now;
+
+	for (uint32_t p=best + 1; p<NUM_PHASES; p++) {
+		if ((waiting & (1U << p)) && (int32_t)(pass[p] - pass[best]) < 0) {
+			best = p;
+		}
+	}
+	return best;
+}
+
+// Every service costs a stride, including forced and starvation picks
+static void wfq_served(uint32_t phase, uint32_t now) {
+	uint32_t weight = PHASES[phase].weight ? PHASES[phase].weight : 1;
+	(void)now;
+	globalPass = pass[phase];
+	pass[phase] += WFQ_STRIDE / weight;
+}
+
+static const PhasePolicy policy = { "wfq", wfq_enqueue, wfq_select, wfq_served };
+
+#else
+#error "Unknown PHASE_POLICY"
+#endif
+
+const PhasePolicy *const phasePolicy = &policy;
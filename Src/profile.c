@@ -0,0 +1,155 @@
+/**
+ * @file profile.c
+ * @brief Cycle-count statistics for the regions listed in profile.h.
+ *
+ * Each region is only recorded from one execution context (its interrupt
+ * handler or the main loop), so recording needs no locking. The counts
+ * include the few cycles of the two counter reads themselves.
+ *
+ * A dump is written a line at a time from the main loop while the log
+ * ring has room, so it never floods the ring the other messages share.
+*/
+
+#ifdef PROFILE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "uart.h"
+#include "profile.h"
+
+#define DEMCR_TRCENA			(1U<<24)
+#define DWT_CTRL_CYCCNTENA		(1U<<0)
+
+#define DUMP_LINE_MAX			96U							// Longest dump line in text mode
+#define TX_RESERVE				(UART_LOG_BUF_SIZE / 4U)	// Log ring space a dump leaves to LOG()
+
+_Static_assert(DUMP_LINE_MAX + TX_RESERVE <= UART_LOG_BUF_SIZE, "Dump line does not fit the log ring");
+
+/** @brief Stats block, placed at PROFILE_STATS_ADDR by the linker script */
+#if defined(__ELF__)
+__attribute__((section(".profile")))
+#endif
+ProfileStats profileStats;
+
+static const char *const regionName[PROF_REGIONS] = {
+	"exti", "tim2", "dma", "events", "changePhase", "lights_commit", "config_load"
+};
+
+static uint32_t dumpRegion = PROF_REGIONS;		// Region being dumped, PROF_REGIONS when idle
+static int32_t dumpBin;							// Next histogram bin, -1 for the summary line
+static ProfileRegionStats dumpSnap;				// Region as it was at its summary line
+
+/**
+ * @brief Start the DWT cycle counter and clear the statistics.
+ *
+ * The `.profile` section is not zeroed by the startup code, so this must
+ * run before the first region is recorded.
+*/
+void profile_init(void) {
+	CoreDebug->DEMCR |= DEMCR_TRCENA;		// Enable the DWT unit
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA;		// Start counting core cycles
+
+	profile_reset();
+}
+
+/** @brief Clear every region and mark the block valid */
+void profile_reset(void) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	for (uint32_t r = 0; r < PROF_REGIONS; r++) {
+		ProfileRegionStats *s = &profileStats.region[r];
+		s->calls = 0;
+		s->min = UINT32_MAX;
+		s->max = 0;
+		s->total = 0;
+		for (uint32_t b = 0; b < PROFILE_HIST_BINS; b++) {
+			s->hist[b] = 0;
+		}
+	}
+	profileStats.regions = PROF_REGIONS;
+	profileStats.dumpRequest = 0;
+	profileStats.magic = PROFILE_MAGIC;
+
+	__set_PRIMASK(primask);
+}
+
+/**
+ * @brief Add one sample to a region.
+ *
+ * @param region Region that just finished
+ * @param cycles Cycles it took
+*/
+void profile_record(ProfileRegion region, uint32_t cycles) {
+	ProfileRegionStats *s = &profileStats.region[region];
+
+	s->calls++;
+	s->total += cycles;
+	if (cycles < s->min) {
+		s->min = cycles;
+	}
+	if (cycles > s->max) {
+		s->max = cycles;
+	}
+
+	uint32_t bin = cycles ? 31U - (uint32_t)__builtin_clz(cycles) : 0;
+	if (bin >= PROFILE_HIST_BINS) {
+		bin = PROFILE_HIST_BINS - 1;
+	}
+	s->hist[bin]++;
+}
+
+/**
+ * @brief Start logging the statistics of every region that ran.
+ *
+ * Only sets the dump cursor; profile_poll() writes the lines.
+*/
+void profile_dump(void) {
+	dumpRegion = 0;
+	dumpBin = -1;
+}
+
+// Log the next line of the dump, false once it is complete
+static bool dump_line(void) {
+	while (dumpRegion < PROF_REGIONS) {
+		if (dumpBin < 0) {
+			dumpSnap = profileStats.region[dumpRegion];
+			if (dumpSnap.calls != 0) {
+				LOG("prof %s calls=%lu min=%lu mean=%lu max=%lu", regionName[dumpRegion], dumpSnap.calls,
+						dumpSnap.min, (uint32_t)(dumpSnap.total / dumpSnap.calls), dumpSnap.max);
+				dumpBin = 0;
+				return true;
+			}
+			dumpBin = PROFILE_HIST_BINS;
+		}
+		for (; dumpBin < PROFILE_HIST_BINS; dumpBin++) {
+			if (dumpSnap.hist[dumpBin]) {
+				LOG("prof %s >=%lu: %lu", regionName[dumpRegion], 1UL << dumpBin, dumpSnap.hist[dumpBin]);
+				dumpBin++;
+				return true;
+			}
+		}
+		dumpRegion++;
+		dumpBin = -1;
+	}
+	return false;
+}
+
+/**
+ * @brief Start a dump requested through `profileStats.dumpRequest` and
+ * write the next lines of a running one - called from the main loop.
+ *
+ * Lines are queued while the log ring keeps TX_RESERVE bytes free; the DMA
+ * completion interrupt wakes the loop for the rest.
+*/
+void profile_poll(void) {
+	if (profileStats.dumpRequest) {
+		profileStats.dumpRequest = 0;
+		profile_dump();
+	}
+	while (dumpRegion < PROF_REGIONS && uart2_write_free() >= DUMP_LINE_MAX + TX_RESERVE && dump_line()) {
+	}
+}
+
+#endif /* PROFILE */
@@ -0,0 +1,250 @@
+/**
+ * @file stats.c
+ * @brief Binned traffic statistics: tier rings, lazy rollover and export frames.
+ *
+ * Time is kept as whole minutes since boot, advanced from the millisecond
+ * timestamps of the reports. Bin n of a tier of width w covers minutes
+ * n*w to (n+1)*w - 1 and lives in slot n % length; a rollover clears at
+ * most `length` slots, however long the intersection was idle.
+ *
+ * Waits are tracked per light without per-vehicle storage: the number of
+ * queued calls and the sum of their offsets from the first one give the
+ * total wait when the GREEN is reached in one subtraction.
+*/
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "uart.h"
+#include "stats.h"
+
+#define MINUTE_MS			60000U
+#define FRAME_HEADER		8U
+#define FRAME_SIZE			(FRAME_HEADER + sizeof(StatsBin) + 2U)
+#define TX_RESERVE			(UART_LOG_BUF_SIZE / 4U)		// Log ring space export frames leave to LOG()
+
+_Static_assert(sizeof(StatsBin) == NUM_LIGHTS * sizeof(StatsLane) + 4U, "StatsBin is sent as is - no padding");
+_Static_assert(sizeof(StatsBin) <= UINT8_MAX, "Frame size byte lets readers skip the frame");
+_Static_assert(FRAME_SIZE + TX_RESERVE <= UART_LOG_BUF_SIZE, "Export frame does not fit the log ring");
+
+typedef struct {
+	uint32_t minutes;
+	uint32_t length;
+	uint32_t newest;					// Current bin number
+	StatsBin *bins;
+} Tier;
+
+#define TIER_STORAGE(width, count)		static StatsBin tierBins##width[count];
+#define TIER_INIT(width, count)			{ width, count, 0, tierBins##width },
+
+STATS_TIERS(TIER_STORAGE)
+static Tier tiers[STATS_NUM_TIERS] = { STATS_TIERS(TIER_INIT) };
+
+static uint32_t minute = 0;				// Minutes since boot
+static uint32_t minuteStart = 0;		// Start of `minute` (ms)
+
+/** @brief Queued calls of a light not yet released by a GREEN */
+static struct {
+	uint32_t count;
+	uint32_t first;						// Time of the oldest call (ms)
+	uint32_t offsets;					// Sum of (call time - first) (ms)
+} waiting[NUM_LIGHTS];
+
+static uint32_t exportTier = STATS_NUM_TIERS;	// Tier being exported, STATS_NUM_TIERS when idle
+static uint32_t exportBin;						// Next bin of that tier to send
+
+static void add16(uint16_t *counter, uint32_t n) {
+	uint32_t v = *counter + n;
+	*counter = (uint16_t)(v > UINT16_MAX ? UINT16_MAX : v);
+}
+
+static void inc8(uint8_t *counter) {
+	if (*counter < UINT8_MAX) {
+		(*counter)++;
+	}
+}
+
+// Oldest bin still held in the ring
+static uint32_t first_bin(const Tier *t) {
+	return t->newest >= t->length ? t->newest - t->length + 1U : 0U;
+}
+
+// Make bin `bin` current, clearing the slots of the bins skipped on the way
+static void roll(Tier *t, uint32_t bin) {
+	uint32_t stale = bin - t->newest;
+	if (stale > t->length) {
+		stale = t->length;
+	}
+	for (uint32_t i = 0; i < stale; i++) {
+		memset(&t->bins[(bin - i) % t->length], 0, sizeof(StatsBin));
+	}
+	t->newest = bin;
+}
+
+// Move the minute clock to `now` - reports come in time order, one behind the clock stays in the current bin
+static void advance(uint32_t now) {
+	if ((int32_t)(now - minuteStart) < (int32_t)MINUTE_MS) {
+		return;
+	}
+	uint32_t steps = (now - minuteStart) / MINUTE_MS;
+	minute += steps;
+	minuteStart += steps * MINUTE_MS;
+	for (uint32_t t = 0; t < STATS_NUM_TIERS; t++) {
+		roll(&tiers[t], minute / tiers[t].minutes);
+	}
+}
+
+static StatsBin *current(uint32_t t) {
+	return &tiers[t].bins[tiers[t].newest % tiers[t].length];
+}
+
+/** @brief Count a detection on a detector of `light` */
+void stats_detection(uint32_t light, uint32_t now) {
+	advance(now);
+	for (uint32_t t = 0; t < STATS_NUM_TIERS; t++) {
+		add16(&current(t)->lane[light].volume, 1);
+	}
+}
+
+/**
+ * @brief A detection joined the queue of a RED light.
+ *
+ * @param queue  Vehicles now waiting at the light
+*/
+void stats_queued(uint32_t light, uint32_t queue, uint32_t now) {
+	advance(now);
+	if (waiting[light].count == 0) {
+		waiting[light].first = now;
+	}
+	waiting[light].offsets += now - waiting[light].first;
+	waiting[light].count++;
+
+	if (queue > STATS_QUEUE_MAX) {
+		queue = STATS_QUEUE_MAX;
+	}
+	for (uint32_t t = 0; t < STATS_NUM_TIERS; t++) {
+		uint16_t *gq = &current(t)->lane[light].greenQueue;
+		if (queue > STATS_QUEUE(*gq)) {
+			*gq = (uint16_t)((queue << 10) | STATS_GREEN(*gq));
+		}
+	}
+}
+
+/**
+ * @brief The queue of `light` is released.
+ *
+ * @param greenAt  Time the light turns GREEN - the end of every queued wait
+*/
+void stats_served(uint32_t light, uint32_t greenAt, uint32_t now) {
+	uint32_t count = waiting[light].count;
+	if (count == 0) {
+		return;
+	}
+	advance(now);
+	uint32_t waitMs = count * (greenAt - waiting[light].first) - waiting[light].offsets;
+	waiting[light].count = 0;
+	waiting[light].offsets = 0;
+
+	for (uint32_t t = 0; t < STATS_NUM_TIERS; t++) {
+		StatsLane *lane = &current(t)->lane[light];
+		add16(&lane->served, count);
+		add16(&lane->waitS, (waitMs + 500U) / 1000U);
+	}
+}
+
+/**
+ * @brief A GREEN ended - credited to the bin in which it ends.
+ *
+ * @param lights   Lights of the phase
+ * @param greenMs  GREEN shown from the end of the clearance
+*/
+void stats_green_end(uint32_t lights, uint32_t greenMs, StatsEnd reason, uint32_t now) {
+	advance(now);
+	uint32_t seconds = (greenMs + 500U) / 1000U;
+
+	for (uint32_t t = 0; t < STATS_NUM_TIERS; t++) {
+		StatsBin *bin = current(t);
+		inc8(reason == STATS_GAP_OUT ? &bin->gapOuts : reason == STATS_MAX_OUT ? &bin->maxOuts : &bin->forced);
+		for (uint32_t i = 0; i < NUM_LIGHTS; i++) {
+			if (lights & (1U << i)) {
+				uint16_t *gq = &bin->lane[i].greenQueue;
+				uint32_t green = STATS_GREEN(*gq) + seconds;
+				if (green > STATS_GREEN_MAX_S) {
+					green = STATS_GREEN_MAX_S;
+				}
+				*gq = (uint16_t)((*gq & ~STATS_GREEN_MAX_S) | green);
+			}
+		}
+	}
+}
+
+/** @brief View of a tier, rolled over to `now` first */
+StatsTier stats_tier(uint32_t tier, uint32_t now) {
+	advance(now);
+	const Tier *t = &tiers[tier];
+	return (StatsTier){ t->minutes, t->length, t->newest, t->bins };
+}
+
+/**
+ * @brief Start streaming every held bin, tier by tier, oldest first.
+ *
+ * @return false if an export is already running
+*/
+bool stats_export(uint32_t now) {
+	if (exportTier < STATS_NUM_TIERS) {
+		return false;
+	}
+	advance(now);
+	exportTier = 0;
+	exportBin = first_bin(&tiers[0]);
+	return true;
+}
+
+// Fletcher-16 of the frame after the sync byte
+static uint16_t fletcher16(const uint8_t *data, uint32_t len) {
+	uint32_t sum1 = 0;
+	uint32_t sum2 = 0;
+	for (uint32_t i = 0; i < len; i++) {
+		sum1 = (sum1 + data[i]) % 255U;
+		sum2 = (sum2 + sum1) % 255U;
+	}
+	return (uint16_t)((sum2 << 8) | sum1);
+}
+
+// Queue one bin as a frame - StatsBin is copied as is, both the target and the host are little-endian
+static void send_frame(const Tier *t, uint32_t bin) {
+	uint8_t frame[FRAME_SIZE];
+	frame[0] = STATS_FRAME_SYNC;
+	frame[1] = (uint8_t)t->minutes;
+	frame[2] = NUM_LIGHTS;
+	frame[3] = sizeof(StatsBin);
+	for (uint32_t i = 0; i < 4; i++) {
+		frame[4 + i] = (uint8_t)(bin >> (8 * i));
+	}
+	memcpy(&frame[FRAME_HEADER], &t->bins[bin % t->length], sizeof(StatsBin));
+	uint16_t check = fletcher16(&frame[1], FRAME_SIZE - 3U);
+	frame[FRAME_SIZE - 2] = (uint8_t)check;
+	frame[FRAME_SIZE - 1] = (uint8_t)(check >> 8);
+	uart2_write_buf((const char *)frame, FRAME_SIZE);
+}
+
+/**
+ * @brief Queue the next export frames - called from the main loop.
+ *
+ * Sends frames while the log ring keeps TX_RESERVE bytes free; the DMA
+ * completion interrupt wakes the loop for the rest.
+*/
+void stats_poll(void) {
+	while (exportTier < STATS_NUM_TIERS && uart2_write_free() >= FRAME_SIZE + TX_RESERVE) {
+		const Tier *t = &tiers[exportTier];
+		if (exportBin < first_bin(t)) {
+			exportBin = first_bin(t);			// Overwritten while exporting
+		}
+		if (exportBin <= t->newest) {
+			send_frame(t, exportBin++);
+		} else if (++exportTier < STATS_NUM_TIERS) {
+			exportBin = first_bin(&tiers[exportTier]);
+		}
+	}
+}
@@ -1,78 +1,151 @@
 /**
  * @file systick.c
- * @brief SysTick timer configuration and millisecond utilities.
- * 
- * This module configures the Cortex-M4 SysTick timer to generate a
- * 1 ms tick interrupt. It maintains a global millisecond counter 
- * ('systickMillis`) and provides functions with time retrieval and
- * busy-wait delays.
+ * @brief System time base and one-shot software timers.
+ *
+ * The periodic 1 ms SysTick interrupt has been replaced by a tickless
+ * design built on the 32-bit TIM2:
+ * 	- TIM2 free-runs at 1 MHz, so `TIM2->CNT` is the microsecond uptime
+ * 	  counter and reading the time never needs an interrupt. The update
+ * 	  interrupt counts its wraps (every ~71.6 minutes) to extend it to a
+ * 	  64-bit time that never wraps in practice.
+ * 	- Software timers are kept in a list sorted by deadline. Only the
+ * 	  earliest deadline is loaded into the TIM2 capture/compare 1 register,
+ * 	  so the core is woken only when a timer is actually due.
+ *
+ * Timer callbacks run in the TIM2 interrupt.
 */
 
 #include "uart.h"
+#include "latency.h"
+#include "profile.h"
 #include "systick.h"
 #include "controller.h"
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include "stm32f446xx.h"
 
-#define SYSTICK_LOAD_VAL		16000
-#define CTRL_ENABLE				(1U<<0)
-#define CTRL_CLKSRC				(1U<<2)
-#define CTRL_COUNTFLAG			(1U<<16)
+#define TIM2EN					(1U<<0)
+#define TIM_CR1_CEN				(1U<<0)
+#define TIM_DIER_UIE			(1U<<0)
+#define TIM_DIER_CC1IE			(1U<<1)
+#define TIM_SR_UIF				(1U<<0)
+#define TIM_SR_CC1IF			(1U<<1)
+#define TIM_EGR_UG				(1U<<0)
+#define TIM_EGR_CC1G			(1U<<1)
 
-volatile uint32_t systickMillis = 0;		// Global variable to store milliseconds
+#define TIMER_CLK				16000000
+#define TICK_FREQ				1000000		// TIM2 counts microseconds
+#define TICKS_PER_MS			(TICK_FREQ / 1000)
+
+static SoftTimer *timerHead = NULL;			// Armed timers sorted by deadline
+static volatile uint32_t wakeups = 0;		// Number of TIM2 compare interrupts taken
+static volatile uint32_t overflows = 0;		// TIM2 wraps - upper word of the 64-bit time
+
+static void timer_program(void);
 
 /**
- * @brief SysTick interrupt handler called every 1 millisecond.
- * 
- * Increments the global milliseocnd counter and calls application-specific
- * timeout functions:
- * 	- checkGreenLightTimeout() to release green light after timeout 
- * 	- SysTick_CheckFirstPressTimeout() to handle first button press delay
- * 
- * @note This interrupt handler is invoked by the Cortex-M4 SysTick
- *       hardware every millisecond (or configured tick period)
+ * @brief TIM2 interrupt handler, called when the counter wraps or the
+ * 		  earliest deadline is reached.
+ *
+ * Counts counter wraps for systickGetMicros(). On a compare event it runs
+ * the callbacks of every expired timer in deadline order and then loads
+ * the next deadline into the compare register.
+ *
+ * @note Callbacks may start or stop timers, including their own.
 */
-void SysTick_Handler(void) {
-	systickMillis++;						// Increment milliseconds counter
-	checkGreenLightTimeout();				 
-	SysTick_CheckFirstPressTimeout();		 
+void TIM2_IRQHandler(void) {
+	PROFILE_BEGIN(PROF_TIM2);
+	uint32_t sr = TIM2->SR;
+
+	if (sr & TIM_SR_UIF) {
+		TIM2->SR = ~TIM_SR_UIF;				// Clear update flag (rc_w0)
+		overflows++;
+	}
+	if (sr & TIM_SR_CC1IF) {
+		TIM2->SR = ~TIM_SR_CC1IF;			// Clear compare flag (rc_w0)
+		wakeups++;
+
+		while (timerHead && (int32_t)(TIM2->CNT - timerHead->deadline) >= 0) {
+			SoftTimer *timer = timerHead;
+			timerHead = timer->next;
+			timer->next = NULL;
+			timer->armed = false;
+			LATENCY_TIMER(TIM2->CNT - timer->deadline);
+			timer->callback();
+		}
+
+		timer_program();
+	}
+	PROFILE_END(PROF_TIM2);
 }
 
 /**
- * @brief Initialize the SysTick timer for 1ms tick interrupts.
- * 
- * Configures the SysTick LOAD register and control register to generate
- * interrupts every millisecond based on the system clock.
+ * @brief Initialize TIM2 as the free-running microsecond time base.
+ *
+ * The counter runs continuously from reset. The update interrupt (once
+ * per wrap) is always enabled; the compare interrupt only while at least
+ * one software timer is armed.
  */
 void systick_init(void) {
 
-	SysTick->LOAD = SYSTICK_LOAD_VAL;		// Reload with number of clocks per ms
-	SysTick->VAL = 0;						// Clear current SysTick counter value
+	RCC->APB1ENR |= TIM2EN;					// Enable clock to TIM2
 
-	// Enable, set clock source, and enable interrupt
-	SysTick->CTRL = CTRL_ENABLE | CTRL_CLKSRC | (1U << 1);
+	TIM2->PSC = (TIMER_CLK / TICK_FREQ) - 1;	// 16 MHz / 16 = 1 MHz
+	TIM2->ARR = 0xFFFFFFFF;					// Full 32-bit range
+	TIM2->EGR = TIM_EGR_UG;					// Load the prescaler
+	TIM2->CNT = 0;
+	TIM2->SR = 0;
+	TIM2->DIER = TIM_DIER_UIE;				// Count wraps for the 64-bit time
+
+	NVIC_EnableIRQ(TIM2_IRQn);
+	TIM2->CR1 = TIM_CR1_CEN;				// Start counting
+}
+
+/**
+ * @brief Get the current system uptime in microseconds.
+ *
+ * Combines the wrap count with `TIM2->CNT`. A wrap whose update interrupt
+ * has not been taken yet (interrupts masked, or called from a handler) is
+ * detected through the pending update flag, so the result is monotonic
+ * when called from any context.
+ *
+ * @return Microseconds elapsed since systick_init()
+ */
+uint64_t systickGetMicros(void) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t hi = overflows;
+	uint32_t lo = TIM2->CNT;
+	if ((TIM2->SR & TIM_SR_UIF) && lo < 0x80000000U) {
+		hi++;								// Wrapped - update interrupt still pending
+	}
+
+	__set_PRIMASK(primask);
+	return ((uint64_t)hi << 32) | lo;
 }
 
 /**
  * @brief Get the current system uptime in milliseconds.
- * 
- * Returns the number of milliseconds elapsed since SysTick initialization.
- * 
+ *
+ * Returns the number of milliseconds elapsed since systick_init(),
+ * truncated to 32 bits (wraps after ~49.7 days).
+ *
  * @return Current millisecond count
  */
 uint32_t systickGetMillis(void) {
-	return systickMillis;					// Return the current milliseconds count
+	return (uint32_t)(systickGetMicros() / TICKS_PER_MS);
 }
 
 /**
  * @brief Busy-wait delay for a specified number of milliseconds.
- * 
+ *
  * Uses `systickGetMillis()` to implement a simple blocking delay.
- * 
+ *
  * @param delay  Number of milliseconds to wait
- * 
+ *
  * @note This is a blocking function and will halt CPU execution.
  * 		 Do not use in time-critical or interrupt-sensitive code.
  */
@@ -80,3 +153,101 @@ void systickDelayMs(int delay) {
 	uint32_t start = systickGetMillis();
 	while (systickGetMillis() - start < delay) {}	// Busy-wait for the specified delay
 }
+
+/**
+ * @brief Arm a one-shot software timer.
+ *
+ * The timer is inserted into the deadline-sorted list. If it is already
+ * armed it is rescheduled. The callback runs from the TIM2 interrupt once
+ * `delayMs` milliseconds have elapsed.
+ *
+ * @param timer    Timer to arm (callback must be set)
+ * @param delayMs  Delay from now in milliseconds, less than SOFT_TIMER_MAX_MS
+ */
+void systick_timer_start(SoftTimer *timer, uint32_t delayMs) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	systick_timer_stop(timer);
+	timer->deadline = TIM2->CNT + delayMs * TICKS_PER_MS;
+	timer->armed = true;
+
+	// Insert after every timer with an earlier or equal deadline
+	SoftTimer **link = &timerHead;
+	while (*link && (int32_t)((*link)->deadline - timer->deadline) <= 0) {
+		link = &(*link)->next;
+	}
+	timer->next = *link;
+	*link = timer;
+
+	if (timerHead == timer) {
+		timer_program();
+	}
+
+	__set_PRIMASK(primask);
+}
+
+/**
+ * @brief Disarm a software timer. Does nothing if it is not armed.
+ *
+ * @param timer  Timer to disarm
+ */
+void systick_timer_stop(SoftTimer *timer) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	if (timer->armed) {
+		SoftTimer **link = &timerHead;
+		while (*link && *link != timer) {
+			link = &(*link)->next;
+		}
+		if (*link) {
+			*link = timer->next;
+		}
+		timer->next = NULL;
+		timer->armed = false;
+	}
+
+	__set_PRIMASK(primask);
+}
+
+/** @brief Check whether a software timer is armed */
+bool systick_timer_active(const SoftTimer *timer) {
+	return timer->armed;
+}
+
+/**
+ * @brief Number of timer interrupts taken since boot.
+ *
+ * With the tickless design this equals the number of times the core was
+ * woken for timekeeping; compare against uptime to get wake-ups per hour.
+ *
+ * @return Wake-up count
+ */
+uint32_t systick_get_wakeups(void) {
+	return wakeups;
+}
+
+/**
+ * @brief Load the earliest deadline into TIM2 CCR1.
+ *
+ * If the deadline has already passed by the time the compare register is
+ * written, the compare event is generated in software so it is not missed
+ * until the counter wraps.
+ *
+ * @note Must be called with interrupts masked or from the TIM2 handler.
+ */
+static void timer_program(void) {
+	if (timerHead == NULL) {
+		TIM2->DIER &= ~TIM_DIER_CC1IE;		// Nothing armed - no wake-ups but wraps
+		return;
+	}
+
+	TIM2->CCR1 = timerHead->deadline;
+	TIM2->SR = ~TIM_SR_CC1IF;
+	TIM2->DIER |= TIM_DIER_CC1IE;
+
+	if ((int32_t)(TIM2->CNT - timerHead->deadline) >= 0) {
+		TIM2->EGR = TIM_EGR_CC1G;			// Already due - fire immediately
+	}
+}
@@ -1,39 +1,99 @@
 /**
  * @file uart.c
  * @brief UART drive implementation
- * 
+ *
  * This file provides low-level UART2 initialization and transmit functionality.
  * The UART is primarily used for serial logging and debug output cia `printf()`
  * redirectiion.
+ *
+ * Output is never transmitted from the caller's context. Bytes are copied
+ * into a log ring buffer and drained to USART2 by DMA1 Stream 6 (channel 4),
+ * so `LOG()` can be used from interrupt handlers without spinning on TXE.
+ *
+ * Received bytes are moved by USART2_IRQHandler() into a receive ring; the
+ * console reads them from the main loop with uart2_read(), so input never
+ * blocks the control loop and is never parsed in interrupt context.
+ *
+ * With `LOG_DEFERRED` defined, `LOG()` emits compact binary records instead
+ * of formatted text (see uart2_log_record()).
 */
 
 #include "stm32f446xx.h"
 #include "uart.h"
+#include "ring.h"
+#include "profile.h"
+#include "systick.h"
 #include <stdint.h>
 
 #define GPIOAEN				(1U<<0)
 #define UART2EN				(1U<<17)
+#define DMA1EN				(1U<<21)
 
 #define CR1_TE				(1U<<3)
 #define CR1_RE				(1U<<2)
+#define CR1_RXNEIE			(1U<<5)
 #define CR1_UE				(1U<<13)
+#define CR3_DMAT			(1U<<7)
 #define SR_TXE				(1U<<7)
+#define SR_TC				(1U<<6)
+#define SR_RXNE				(1U<<5)
+#define SR_ORE				(1U<<3)
+
+#define DMA_SCR_EN			(1U<<0)
+#define DMA_SCR_TCIE		(1U<<4)
+#define DMA_SCR_DIR_M2P		(1U<<6)
+#define DMA_SCR_MINC		(1U<<10)
+#define DMA_SCR_CHSEL_4		(4U<<25)
+#define DMA_HISR_TCIF6		(1U<<21)
+#define DMA_HIFCR_ALL6		(0x3DU<<16)		// Clear TC, HT, TE, DME and FE flags of stream 6
 
 #define SYS_FREQ			16000000
 #define APB1_CLK			SYS_FREQ
 #define UART_BAUDRATE		115200
 
+#define LOG_MASK			(UART_LOG_BUF_SIZE - 1U)
+
+#if (UART_LOG_BUF_SIZE & LOG_MASK) != 0
+#error "UART_LOG_BUF_SIZE must be a power of two"
+#endif
+
+// Log ring state - indices are free-running and masked on access
+static uint8_t logBuf[UART_LOG_BUF_SIZE];
+static volatile uint32_t logHead = 0;		// Next byte to be written by a producer
+static volatile uint32_t logTail = 0;		// Oldest byte not yet transmitted
+static volatile uint32_t logDmaLen = 0;		// Bytes owned by the running DMA transfer (0 = idle)
+static volatile uint32_t logDropped = 0;	// Total bytes lost to overflow
+#if UART_LOG_OVERFLOW == LOG_OVERFLOW_REPORT
+static uint32_t logReported = 0;			// Dropped bytes already reported on the wire
+#elif UART_LOG_OVERFLOW == LOG_OVERFLOW_DROP_OLDEST
+#define LOG_MARKS			32U				// Record starts remembered (power of two)
+#define MARK_MASK			(LOG_MARKS - 1U)
+static uint32_t logMarks[LOG_MARKS];		// Ring index where each queued record starts, oldest first
+static uint32_t markHead = 0;
+static uint32_t markTail = 0;
+#endif
+
+// Receive ring - USART2_IRQHandler produces, the main loop consumes
+RING_SPSC_DEFINE(RxRing, rx_ring, uint8_t, UART_RX_BUF_SIZE)
+static RxRing rx;
+static volatile uint32_t rxOverruns = 0;	// Bytes lost in the USART before the handler ran
+
 // Function Prototypes
 static void uart_set_baudrate(USART_TypeDef *USARTx, uint32_t PeriphClk, uint32_t BaudRate);
 static uint16_t compute_uart_bd(uint32_t PeriphClk, uint32_t BaudRate);
+static void log_dma_start(void);
+static void log_copy(const char *buf, uint32_t len);
+#if UART_LOG_OVERFLOW == LOG_OVERFLOW_DROP_OLDEST
+static void log_drop_oldest(uint32_t need);
+#endif
 
 /**
  * @brief Low-level character output function for printf redirection.
- * 
+ *
  * This function is called by the C standard library to output characters
- * when using fucntions such as `printf()`. Characters are transmitted 
+ * when using fucntions such as `printf()`. Characters are transmitted
  * over UART2.
- * 
+ *
  * @param ch 	Character to transmit
  * @return 		The transmitted character
 */
@@ -42,11 +102,29 @@ int __io_putchar(int ch) {
 	return ch;
 }
 
+/**
+ * @brief Newlib write hook for stdout/stderr.
+ *
+ * Overrides the weak per-character implementation in syscalls.c so that a
+ * whole `printf()` buffer is queued with a single call.
+ *
+ * @param file 	File descriptor (ignored)
+ * @param ptr 	Data to transmit
+ * @param len 	Number of bytes
+ * @return 		Number of bytes consumed
+*/
+int _write(int file, char *ptr, int len) {
+	(void)file;
+	uart2_write_buf(ptr, (uint32_t)len);
+	return len;
+}
+
 /**
  * @brief Initialize UART2 peripheral.
- * 
+ *
  * UART2 is configured for basic asynchronous communication and is used
- * primarily for logging and debugging.
+ * primarily for logging and debugging. Transmission is handled by
+ * DMA1 Stream 6 on channel 4 (USART2_TX); reception by the RXNE interrupt.
 */
 void uart2_init(void) {
 
@@ -61,32 +139,300 @@ void uart2_init(void) {
 	GPIOA->AFR[0] |= (7U<<12);			// Set PA3 AF to UART2_RX (AF07)
 
 	RCC->APB1ENR |= UART2EN;			// Enable clock to UART2
+	RCC->AHB1ENR |= DMA1EN;				// Enable clock to DMA1
 
 	// Configure baudrate USART2 and USART4
 	uart_set_baudrate(USART2, APB1_CLK, UART_BAUDRATE);
 
-	USART2->CR1 = (CR1_TE | CR1_RE);	// Configure the transfer direction
+	USART2->CR1 = (CR1_TE | CR1_RE | CR1_RXNEIE);	// Transfer direction, receive interrupt
+	USART2->CR3 |= CR3_DMAT;			// Transmit requests served by DMA
+
+	// DMA1 Stream 6: channel 4, memory to peripheral, memory increment, TC interrupt
+	DMA1_Stream6->CR = 0;
+	while (DMA1_Stream6->CR & DMA_SCR_EN) {}
+	DMA1_Stream6->PAR = (uintptr_t)&USART2->DR;
+	DMA1_Stream6->CR = DMA_SCR_CHSEL_4 | DMA_SCR_MINC | DMA_SCR_DIR_M2P | DMA_SCR_TCIE;
+	DMA1->HIFCR = DMA_HIFCR_ALL6;
+	NVIC_EnableIRQ(DMA1_Stream6_IRQn);
 
 	USART2->CR1 |= CR1_UE;				// Enable USART Module
+	USART2->SR &= ~SR_TC;				// Clear TC before the first DMA transfer
+	NVIC_EnableIRQ(USART2_IRQn);
 }
 
 /**
- * @brief Transmit a single character over UART2.
- * 
- * This function blocks until the transmit data register is empty,
- * then writes the provided character to the UART data register.
- * 
+ * @brief Queue a single character for transmission over UART2.
+ *
+ * Never blocks; the character is placed in the log ring and sent by DMA.
+ *
  * @param ch  Character to transmit.
 */
 void uart2_write(int ch) {
-	while(!(USART2->SR & SR_TXE)){};	// Make sure the transmit data register is empty.
-	USART2->DR = (ch & 0xFF);			// Write to transmit data register
+	char c = (char)ch;
+	uart2_write_buf(&c, 1);
+}
+
+/**
+ * @brief Queue a buffer for transmission over UART2.
+ *
+ * Safe to call from thread and interrupt context. The copy into the ring
+ * runs with interrupts masked for a few cycles per byte; the caller never
+ * waits for the line. When the ring cannot hold the data the configured
+ * `UART_LOG_OVERFLOW` policy decides what is lost.
+ *
+ * @param buf  Bytes to transmit
+ * @param len  Number of bytes
+ * @return     Number of bytes queued (0 if the message was dropped)
+*/
+uint32_t uart2_write_buf(const char *buf, uint32_t len) {
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t space = UART_LOG_BUF_SIZE - (logHead - logTail);
+
+#if UART_LOG_OVERFLOW == LOG_OVERFLOW_DROP_OLDEST
+	if (len > space) {
+		log_drop_oldest(len - space);
+		space = UART_LOG_BUF_SIZE - (logHead - logTail);
+	}
+#elif UART_LOG_OVERFLOW == LOG_OVERFLOW_REPORT
+	if (logDropped != logReported) {
+		static const char head[] = "\r\n[log] ";
+		static const char tail[] = " bytes dropped\r\n";
+		char note[sizeof(head) - 1 + 10 + sizeof(tail) - 1];		// Up to 10 digits of a uint32_t
+		uint32_t n = 0;
+		char digits[10];
+		uint32_t d = 0;
+		uint32_t lost = logDropped - logReported;
+		do { digits[d++] = (char)('0' + lost % 10); lost /= 10; } while (lost);
+		for (const char *p = head; *p; ) note[n++] = *p++;
+		while (d) note[n++] = digits[--d];
+		for (const char *p = tail; *p; ) note[n++] = *p++;
+
+		if (n + len <= space) {
+			log_copy(note, n);
+			space -= n;
+			logReported = logDropped;
+		}
+	}
+#endif
+
+	if (len > space) {
+		logDropped += len;
+		__set_PRIMASK(primask);
+		return 0;
+	}
+
+#if UART_LOG_OVERFLOW == LOG_OVERFLOW_DROP_OLDEST
+	if (markHead - markTail == LOG_MARKS) {
+		markTail++;							// Oldest record merges into the one before it
+	}
+	logMarks[markHead++ & MARK_MASK] = logHead;
+#endif
+	log_copy(buf, len);
+	if (logDmaLen == 0) {
+		log_dma_start();
+	}
+
+	__set_PRIMASK(primask);
+	return len;
+}
+
+/** @brief Bytes the log ring can take before the next message is dropped */
+uint32_t uart2_write_free(void) {
+	return UART_LOG_BUF_SIZE - (logHead - logTail);
+}
+
+/** @brief Total number of log bytes discarded because the ring was full */
+uint32_t uart2_log_dropped(void) {
+	return logDropped;
+}
+
+/**
+ * @brief Queue a deferred log record.
+ *
+ * Called by the `LOG()` macro when `LOG_DEFERRED` is defined. The record is
+ * encoded as:
+ *
+ * 	LOG_RECORD_SYNC | varint(format address) | varint(ms since previous record) | varint(arg)...
+ *
+ * Varints are little-endian base-128 (LEB128). The argument count is not sent;
+ * the decoder derives it from the format string.
+ *
+ * @param fmt 	Format string placed in the `.logfmt` section
+ * @param nargs Number of argument words
+ * @param args 	Argument words
+*/
+void uart2_log_record(const char *fmt, uint32_t nargs, const uint32_t *args) {
+	static uint32_t lastStamp = 0;
+	uint8_t rec[1 + (2 + LOG_MAX_ARGS) * 5];
+	uint32_t words[2 + LOG_MAX_ARGS];
+	uint32_t len = 0;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t now = systickGetMillis();
+	words[0] = (uint32_t)(uintptr_t)fmt;
+	words[1] = now - lastStamp;
+	for (uint32_t i = 0; i < nargs && i < LOG_MAX_ARGS; i++) {
+		words[2 + i] = args[i];
+	}
+
+	rec[len++] = LOG_RECORD_SYNC;
+	for (uint32_t i = 0; i < 2 + nargs && i < 2 + LOG_MAX_ARGS; i++) {
+		uint32_t v = words[i];
+		while (v >= 0x80U) {
+			rec[len++] = (uint8_t)(v | 0x80U);
+			v >>= 7;
+		}
+		rec[len++] = (uint8_t)v;
+	}
+
+	// Only advance the time base when the record made it into the ring
+	if (uart2_write_buf((const char *)rec, len)) {
+		lastStamp = now;
+	}
+
+	__set_PRIMASK(primask);
+}
+
+/**
+ * @brief DMA1 Stream 6 interrupt handler (USART2_TX).
+ *
+ * Releases the bytes of the completed transfer and starts the next one
+ * if more data was queued in the meantime.
+*/
+void DMA1_Stream6_IRQHandler(void) {
+	PROFILE_BEGIN(PROF_DMA);
+	if (DMA1->HISR & DMA_HISR_TCIF6) {
+		DMA1->HIFCR = DMA_HIFCR_ALL6;
+		logTail += logDmaLen;
+		logDmaLen = 0;
+		if (logHead != logTail) {
+			log_dma_start();
+		}
+	}
+	PROFILE_END(PROF_DMA);
+}
+
+/**
+ * @brief USART2 interrupt handler - receive side.
+ *
+ * Moves one received byte into the receive ring. Reading SR then DR
+ * clears RXNE and ORE; a byte that arrives while the ring is full is
+ * dropped and counted.
+*/
+void USART2_IRQHandler(void) {
+	uint32_t sr = USART2->SR;
+	if (sr & (SR_RXNE | SR_ORE)) {
+		uint8_t byte = (uint8_t)USART2->DR;
+		if (sr & SR_ORE) {
+			rxOverruns++;
+		}
+		rx_ring_push(&rx, &byte);
+	}
+}
+
+/**
+ * @brief Take the oldest received byte - main loop only.
+ *
+ * @param byte  Receives the byte
+ * @return      false if nothing was received
+*/
+bool uart2_read(uint8_t *byte) {
+	return rx_ring_pop(&rx, byte) == RING_OK;
+}
+
+/** @brief Received bytes are waiting to be read */
+bool uart2_rx_pending(void) {
+	return !rx_ring_empty(&rx);
+}
+
+/** @brief Received bytes lost to USART overrun or a full receive ring */
+uint32_t uart2_rx_dropped(void) {
+	return rxOverruns + rx.dropped;
+}
+
+/** @brief Copy bytes into the ring at the head - caller holds interrupts masked */
+static void log_copy(const char *buf, uint32_t len) {
+	uint32_t head = logHead;
+	for (uint32_t i = 0; i < len; i++) {
+		logBuf[(head + i) & LOG_MASK] = (uint8_t)buf[i];
+	}
+	logHead = head + len;
+}
+
+#if UART_LOG_OVERFLOW == LOG_OVERFLOW_DROP_OLDEST
+/**
+ * @brief Discard the oldest undelivered records until `need` more bytes fit.
+ *
+ * The DMA owns [logTail, logTail + logDmaLen) and the record it stops in
+ * must still go out whole, so the cut starts at the first record that
+ * begins after that span and removes whole records only. The newer records
+ * are moved down over the cut. Nothing is discarded when even every
+ * undelivered record would not make room - the new record is dropped then.
+ * Caller holds interrupts masked.
+*/
+static void log_drop_oldest(uint32_t need) {
+	uint32_t busy = logTail + logDmaLen;
+	while (markTail != markHead && (int32_t)(logMarks[markTail & MARK_MASK] - busy) < 0) {
+		markTail++;							// Record already (partly) handed to the DMA
+	}
+	if (markTail == markHead || logHead - logMarks[markTail & MARK_MASK] < need) {
+		return;
+	}
+
+	uint32_t from = logMarks[markTail & MARK_MASK];
+	uint32_t next = markTail + 1U;
+	while (next != markHead && logMarks[next & MARK_MASK] - from < need) {
+		next++;
+	}
+	uint32_t to = (next != markHead) ? logMarks[next & MARK_MASK] : logHead;
+	uint32_t cut = to - from;
+
+	for (uint32_t i = to; i != logHead; i++) {
+		logBuf[(i - cut) & LOG_MASK] = logBuf[i & LOG_MASK];
+	}
+	logHead -= cut;
+	logDropped += cut;
+
+	if (next == markHead) {
+		markHead = markTail;				// Every undelivered record went
+		return;
+	}
+	uint32_t out = markTail + 1U;			// The record at `to` now starts at `from`
+	for (uint32_t m = next + 1U; m != markHead; m++) {
+		logMarks[out++ & MARK_MASK] = logMarks[m & MARK_MASK] - cut;
+	}
+	markHead = out;
+}
+#endif
+
+/**
+ * @brief Hand the next contiguous run of queued bytes to the DMA.
+ *
+ * A transfer never wraps the ring; the remainder is sent by the next
+ * transfer started from the completion interrupt.
+*/
+static void log_dma_start(void) {
+	uint32_t start = logTail & LOG_MASK;
+	uint32_t len = logHead - logTail;
+	if (len > UART_LOG_BUF_SIZE - start) {
+		len = UART_LOG_BUF_SIZE - start;
+	}
+
+	logDmaLen = len;
+	DMA1->HIFCR = DMA_HIFCR_ALL6;
+	DMA1_Stream6->M0AR = (uintptr_t)&logBuf[start];
+	DMA1_Stream6->NDTR = len;
+	DMA1_Stream6->CR |= DMA_SCR_EN;
 }
 
 /** @brief Configure the baud rate for the USART peripheral */
-static void uart_set_baudrate(USART_TypeDef *USARTx, 
-							  uint32_t PeriphClk, 
-							  uint32_t BaudRate) 
+static void uart_set_baudrate(USART_TypeDef *USARTx,
+							  uint32_t PeriphClk,
+							  uint32_t BaudRate)
 {
 	USARTx->BRR = compute_uart_bd(PeriphClk, BaudRate);
 }
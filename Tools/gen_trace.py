@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""
+Generate a synthetic arrival trace for the host simulation (`make sim`).
+
+Arrivals are Poisson per lane, optionally with a rush-hour peak, and are
+written sorted by time in the formats read by `Traffic_Control_sim -f`:
+
+    CSV     time_ms,lane        (lanes numbered from 1)
+    .bin    <uint32 time_ms><uint32 lane> little-endian records
+
+Usage:
+    gen_trace.py out.csv|out.bin [--hours H] [--rate VEH_PER_MIN] [--lanes N]
+                 [--peak FACTOR] [--seed S]
+"""
+
+import argparse
+import heapq
+import math
+import random
+import struct
+
+
+def arrivals(lanes, rate_per_min, hours, peak, rng):
+    """Yield (time_ms, lane) pairs in time order."""
+    end_ms = hours * 3600 * 1000
+    base = rate_per_min / 60000.0
+    top = base * max(peak, 1.0)
+
+    # Thinning: draw at the peak rate, keep with probability rate(t)/top
+    def rate(t):
+        if peak <= 1.0:
+            return base
+        hour = (t / 3600000.0) % 24
+        bump = math.exp(-((hour - 8) ** 2) / 2) + math.exp(-((hour - 17) ** 2) / 2)
+        return base * (1 + (peak - 1) * min(bump, 1.0))
+
+    heap = [(rng.expovariate(top), lane) for lane in range(1, lanes + 1)]
+    heapq.heapify(heap)
+    while heap:
+        t, lane = heapq.heappop(heap)
+        if t >= end_ms:
+            continue
+        if rng.random() * top < rate(t):
+            yield int(t), lane
+        heapq.heappush(heap, (t + rng.expovariate(top), lane))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate a detector arrival trace")
+    parser.add_argument("output", help="trace file (.csv or .bin)")
+    parser.add_argument("--hours", type=float, default=24, help="trace length (default 24)")
+    parser.add_argument("--rate", type=float, default=3, help="vehicles per minute per lane (default 3)")
+    parser.add_argument("--lanes", type=int, default=4, help="number of lanes (default 4)")
+    parser.add_argument("--peak", type=float, default=1, help="rush-hour rate multiplier (default 1, flat)")
+    parser.add_argument("--seed", type=int, default=1, help="random seed (default 1)")
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    events = arrivals(args.lanes, args.rate, args.hours, args.peak, rng)
+    count = 0
+
+    if args.output.endswith(".bin"):
+        rec = struct.Struct("<II")
+        with open(args.output, "wb") as f:
+            for t, lane in events:
+                f.write(rec.pack(t, lane))
+                count += 1
+    else:
+        with open(args.output, "w") as f:
+            f.write("time_ms,lane\n")
+            for t, lane in events:
+                f.write(f"{t},{lane}\n")
+                count += 1
+
+    print(f"{args.output}: {count} arrivals")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""
+Decoder for deferred LOG() records (build with LOG_MODE=deferred).
+
+Each record on the wire is:
+
+    0xA5 | varint(format address) | varint(ms since previous record) | varint(arg)...
+
+The format strings live in the non-loaded `.logfmt` section of the ELF file;
+string arguments are resolved from the loaded sections (e.g. `.rodata`).
+Bytes outside of a record (boot text, overflow notes) are passed through.
+
+Statistics export frames (0xA6, see Inc/stats.h and Tools/statsdecode.py)
+share the line and may hold 0xA5 bytes. A frame is recognised by its size
+byte and checksum and skipped whole; a 0xA6 that does not start a valid
+frame is passed through as text.
+
+Usage:
+    logdecode.py Traffic_Control.elf [input] [--time]
+
+`input` is a file or serial device holding the raw byte stream (default stdin).
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+RECORD_SYNC = 0xA5
+FRAME_SYNC = 0xA6
+FRAME_HEADER = 7                        # minutes, lights, size, bin (u32) after the sync
+
+# printf conversion: flags, width, precision, length modifier, conversion
+SPEC = re.compile(r"%([-+ #0]*)(\d*|\*)(?:\.(\d*))?(hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+class Elf32:
+    """Minimal little-endian ELF32 section reader."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1:
+            raise ValueError(f"{path}: not an ELF32 file")
+
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", self.data, 0x2E)
+
+        headers = []
+        for i in range(shnum):
+            headers.append(struct.unpack_from("<IIIIIIIIII", self.data, shoff + i * shentsize))
+
+        names = headers[shstrndx]
+        self.sections = {}
+        self.loaded = []
+        for (name, stype, flags, addr, offset, size, *_rest) in headers:
+            end = self.data.index(b"\0", names[4] + name)
+            sname = self.data[names[4] + name:end].decode()
+            body = self.data[offset:offset + size] if stype != 8 else b""   # SHT_NOBITS
+            self.sections[sname] = (addr, body)
+            if flags & 0x2 and body:                                        # SHF_ALLOC
+                self.loaded.append((addr, body))
+
+    def cstring(self, addr, section=None):
+        regions = [self.sections[section]] if section else self.loaded
+        for base, body in regions:
+            if base <= addr < base + len(body):
+                start = addr - base
+                return body[start:body.index(b"\0", start)].decode(errors="replace")
+        return None
+
+
+class Stream:
+    """Byte reader with push-back, so a rejected frame can be read again as text."""
+
+    def __init__(self, raw):
+        self.raw = raw
+        self.back = bytearray()
+
+    def read(self, n):
+        data = bytes(self.back[:n])
+        del self.back[:n]
+        while len(data) < n:
+            more = self.raw.read(n - len(data))
+            if not more:
+                break
+            data += more
+        return data
+
+    def unread(self, data):
+        self.back[:0] = data
+
+
+def fletcher16(data):
+    sum1 = sum2 = 0
+    for b in data:
+        sum1 = (sum1 + b) % 255
+        sum2 = (sum2 + sum1) % 255
+    return (sum2 << 8) | sum1
+
+
+def skip_frame(stream):
+    """Consume the stats frame after a FRAME_SYNC byte, or push it back if it is not one."""
+    header = stream.read(FRAME_HEADER)
+    if len(header) == FRAME_HEADER:
+        body = stream.read(header[2] + 2)
+        frame = header + body
+        if len(body) == header[2] + 2:
+            check, = struct.unpack_from("<H", frame, len(frame) - 2)
+            if fletcher16(frame[:-2]) == check:
+                return True
+    else:
+        frame = header
+    stream.unread(frame)
+    return False
+
+
+def varint(stream):
+    value, shift = 0, 0
+    while True:
+        b = stream.read(1)
+        if not b:
+            raise EOFError
+        value |= (b[0] & 0x7F) << shift
+        if b[0] < 0x80:
+            return value
+        shift += 7
+
+
+def render(elf, fmt, args):
+    args = iter(args)
+
+    def convert(m):
+        flags, width, prec, _length, conv = m.groups()
+        if conv == "%":
+            return "%"
+        value = next(args, 0)
+        if conv == "s":
+            text = elf.cstring(value)
+            value = text if text is not None else f"<0x{value:08x}>"
+        elif conv in "di" and value & 0x80000000:
+            value -= 1 << 32
+        elif conv == "c":
+            value = chr(value & 0xFF)
+        elif conv == "p":
+            return f"0x{value:08x}"
+        pyconv = "d" if conv in "iu" else conv
+        spec = "%" + flags + width + ("." + prec if prec is not None else "") + pyconv
+        return spec % value
+
+    return SPEC.sub(convert, fmt)
+
+
+def decode(elf, stream, out, show_time):
+    now = 0
+    text = bytearray()
+    stream = Stream(stream)
+    while True:
+        b = stream.read(1)
+        if not b:
+            break
+        if b[0] == FRAME_SYNC and skip_frame(stream):
+            continue
+        if b[0] != RECORD_SYNC:
+            text += b
+            if b == b"\n":
+                out.write(text.decode(errors="replace"))
+                text.clear()
+            continue
+
+        try:
+            addr = varint(stream)
+            now += varint(stream)
+            fmt = elf.cstring(addr, ".logfmt")
+            if fmt is None:
+                out.write(f"<unknown format 0x{addr:x}>\n")
+                continue
+            nargs = sum(1 for m in SPEC.finditer(fmt) if m.group(5) != "%")
+            args = [varint(stream) for _ in range(nargs)]
+        except EOFError:
+            break
+
+        line = render(elf, fmt, args)
+        if show_time:
+            line = f"[{now / 1000:10.3f}] {line}"
+        out.write(line + "\n")
+        out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode deferred LOG() records")
+    parser.add_argument("elf", help="firmware ELF built with LOG_MODE=deferred")
+    parser.add_argument("input", nargs="?", help="raw log stream (file or serial device)")
+    parser.add_argument("--time", action="store_true", help="prefix lines with the target timestamp")
+    args = parser.parse_args()
+
+    elf = Elf32(args.elf)
+    if ".logfmt" not in elf.sections:
+        sys.exit(f"{args.elf}: no .logfmt section (was it built with LOG_MODE=deferred?)")
+
+    stream = open(args.input, "rb", buffering=0) if args.input else sys.stdin.buffer
+    try:
+        decode(elf, stream, sys.stdout, args.time)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
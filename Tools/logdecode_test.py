@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+Decoder test for a mixed deferred log stream (`make decodetest`).
+
+Builds the bytes the firmware puts on the line - boot text, deferred
+records and statistics export frames whose bin counters hold 0xA5 and 0xA6
+bytes - and checks that logdecode.py prints exactly the text and records,
+skips the frames whole, and that statsdecode.py still finds every frame in
+the same capture. A stray 0xA6 that does not start a valid frame must not
+swallow the record after it.
+"""
+
+import io
+import struct
+import sys
+
+import logdecode
+import statsdecode
+
+LIGHTS = 4
+
+FORMATS = {0x100: "boot %u", 0x140: "light %lu %s", 0x180: "queue %d"}
+STRINGS = {0x8000: "GREEN"}
+
+
+class FakeElf:
+    """The two lookups decode() makes, without an ELF file."""
+
+    def cstring(self, addr, section=None):
+        return (FORMATS if section == ".logfmt" else STRINGS).get(addr)
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        out.append((value & 0x7F) | (0x80 if value > 0x7F else 0))
+        value >>= 7
+        if not value:
+            return bytes(out)
+
+
+def record(addr, delta, *args):
+    return bytes([logdecode.RECORD_SYNC]) + varint(addr) + varint(delta) + b"".join(
+        varint(a & 0xFFFFFFFF) for a in args)
+
+
+def frame(minutes, index, fill):
+    size = LIGHTS * 8 + 4
+    body = struct.pack("<BBBI", minutes, LIGHTS, size, index) + bytes([fill]) * size
+    return bytes([statsdecode.FRAME_SYNC]) + body + struct.pack("<H", statsdecode.fletcher16(body))
+
+
+def main():
+    stream = b"".join([
+        b"Traffic controller\r\n",
+        record(0x100, 0, 1),
+        frame(1, 0xA5A5, 0xA5),                 # Sync bytes of both kinds inside frames
+        frame(5, 7, 0xA6),
+        record(0x140, 250, 2, 0x8000),
+        frame(15, 3, 0xA5),
+        b"\xa6",                                # Not a frame: the record after it still decodes
+        record(0x180, 5, -1),
+    ])
+
+    out = io.StringIO()
+    logdecode.decode(FakeElf(), io.BytesIO(stream), out, show_time=True)
+    lines = out.getvalue().splitlines()
+    expected = [
+        "Traffic controller",
+        "[     0.000] boot 1",
+        "[     0.250] light 2 GREEN",
+        "[     0.255] queue -1",
+    ]
+
+    frames = [(minutes, index) for minutes, index, _lanes, _ends in statsdecode.frames(stream)]
+
+    passed = True
+    if [l.rstrip("\r") for l in lines] != expected:
+        print("  decoded lines differ:")
+        for l in lines:
+            print(f"    {l!r}")
+        passed = False
+    if frames != [(1, 0xA5A5), (5, 7), (15, 3)]:
+        print(f"  statsdecode found {frames}")
+        passed = False
+
+    print(f"decoded     {len(lines)} lines, {len(frames)} frames skipped")
+    print(f"log decode test {'PASS' if passed else 'FAIL'}")
+    return 0 if passed else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
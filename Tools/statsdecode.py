@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""
+Decoder for the statistics export frames (console `export`, see Inc/stats.h).
+
+Each frame on the wire is:
+
+    0xA6 | minutes | lights | size | bin (u32) | StatsBin | fletcher16 (u16)
+
+little-endian, with the checksum over every byte after the sync. A StatsBin
+holds per light `volume, served, waitS, greenQueue` (u16 each, GREEN used in
+bits 0-9 and max queue in bits 10-15 of greenQueue) followed by the gap-out,
+max-out and forced-end counts (u8 each) and a pad byte. Bytes outside a
+valid frame (log text, deferred log records) are skipped.
+
+Usage:
+    statsdecode.py [input] [--csv]
+
+`input` is a file or serial device holding the raw byte stream (default stdin).
+"""
+
+import argparse
+import struct
+import sys
+
+FRAME_SYNC = 0xA6
+HEADER = struct.Struct("<BBBI")         # minutes, lights, size, bin
+
+
+def fletcher16(data):
+    sum1 = sum2 = 0
+    for b in data:
+        sum1 = (sum1 + b) % 255
+        sum2 = (sum2 + sum1) % 255
+    return (sum2 << 8) | sum1
+
+
+def frames(data):
+    """Yield (minutes, bin, lanes, ends) for every frame with a valid checksum."""
+    pos = 0
+    while True:
+        pos = data.find(bytes([FRAME_SYNC]), pos)
+        if pos < 0 or pos + 1 + HEADER.size > len(data):
+            return
+        minutes, lights, size, index = HEADER.unpack_from(data, pos + 1)
+        end = pos + 1 + HEADER.size + size + 2
+        if size != lights * 8 + 4 or end > len(data):
+            pos += 1
+            continue
+        check, = struct.unpack_from("<H", data, end - 2)
+        if fletcher16(data[pos + 1:end - 2]) != check:
+            pos += 1
+            continue
+
+        body = data[pos + 1 + HEADER.size:end - 2]
+        lanes = [struct.unpack_from("<HHHH", body, 8 * i) for i in range(lights)]
+        ends = struct.unpack_from("<BBB", body, 8 * lights)
+        yield minutes, index, lanes, ends
+        pos = end
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode statistics export frames")
+    parser.add_argument("input", nargs="?", help="raw byte stream (file or serial device)")
+    parser.add_argument("--csv", action="store_true", help="one CSV row per light and bin")
+    args = parser.parse_args()
+
+    stream = open(args.input, "rb") if args.input else sys.stdin.buffer
+    data = stream.read()
+
+    if args.csv:
+        print("minutes,start_min,light,volume,served,wait_s,green_s,max_queue,gap_outs,max_outs,forced")
+    tier = None
+    for minutes, index, lanes, (gap, maxout, forced) in frames(data):
+        start = index * minutes
+        if args.csv:
+            for light, (volume, served, wait, gq) in enumerate(lanes, 1):
+                print(f"{minutes},{start},{light},{volume},{served},{wait},{gq & 0x3FF},{gq >> 10},"
+                      f"{gap},{maxout},{forced}")
+            continue
+
+        if minutes != tier:
+            tier = minutes
+            print(f"\n{minutes}-minute bins (light: volume/served avg-wait green max-queue)")
+        cells = []
+        for light, (volume, served, wait, gq) in enumerate(lanes, 1):
+            avg = wait / served if served else 0.0
+            cells.append(f"{light}: {volume:3}/{served:<3} {avg:5.1f}s {gq & 0x3FF:4}s q{gq >> 10:<2}")
+        print(f"{start // 60:3}:{start % 60:02}  " + "  ".join(cells) + f"  ends g{gap} m{maxout} f{forced}")
+
+
+if __name__ == "__main__":
+    main()